@@ -20,6 +20,7 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <unistd.h>
 #include "idmf_api.h"
 
 idmf_board * idmf;
@@ -106,11 +107,7 @@ int main(int argc, char * argv[]) {
 			scanf("%d", &channel);
 			idmf_adc_config(idmf, (__u16 ) (65536.0 * 3.2768 / 5.0),
 					(__u16 ) (65536.0 * 4.0100 / 5.0));
-			idmf_adc_request(idmf);
-			usleep(1);	//in RTDM task context use rtdm_task_sleep() <- sleep in nanoseconds
-			idmf_adc_run(idmf);
-			usleep(3);  //in RTDM task context use rtdm_task_sleep() <- sleep in nanoseconds
-			idmf_adc_acquire(idmf);
+			idmf_adc_update(idmf);
 			value = idmf_adc_read(idmf, channel);
 			printf("Value : %d\n", value);
 
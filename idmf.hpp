@@ -0,0 +1,424 @@
+/*
+ * Author Wojciech Domski 2015
+ * www.domski.pl
+ *
+ * C++17 interface of the IDMF API. Channels are template arguments, so
+ * invalid channels are rejected by the compiler and register offsets are
+ * compile-time constants.
+ *
+ *	idmf::board board("idmf0");
+ *
+ *	board.dac<5>() = 1000;
+ *	board.dac_update();
+ *	std::int32_t count = board.enc<3>().read();
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef __IDMF_HPP
+#define __IDMF_HPP
+
+#if __cplusplus < 201703L
+#error "idmf.hpp requires C++17"
+#endif
+
+#include <cstdint>
+#include <utility>
+
+#include "idmf_api.h"
+
+namespace idmf {
+
+/* register map */
+namespace reg {
+
+inline constexpr std::uint32_t dac_conf = DAC_CONF;
+inline constexpr std::uint32_t prt_ctrl = PRT_CTRL;
+inline constexpr std::uint32_t enc_pwrctrl = ENC_PWRCTRL;
+inline constexpr std::uint32_t gpio_dir0 = GPIO_DIR0;
+inline constexpr std::uint32_t gpio_dir1 = GPIO_DIR1;
+inline constexpr std::uint32_t enc_alarm0 = ENC_ALARM0;
+inline constexpr std::uint32_t enc_alarm1 = ENC_ALARM1;
+inline constexpr std::uint32_t enc_pwrstat = ENC_PWRSTAT;
+inline constexpr std::uint32_t bct_led = BCT_LED;
+inline constexpr std::uint32_t bct_pwr = BCT_PWR;
+inline constexpr std::uint32_t gpio_in = GPIO_IN;
+inline constexpr std::uint32_t gpio_out = GPIO_OUT;
+
+/* DAC_CONF value latching all DAC_VALUE registers */
+inline constexpr std::uint32_t dac_latch = 0x0000C000;
+
+template<unsigned N>
+constexpr std::uint32_t dac_value() {
+	static_assert(N < NUM_DACS, "invalid DAC channel");
+	return DAC_VALUE + N * 0x04;
+}
+
+template<unsigned N>
+constexpr std::uint32_t prt_value() {
+	static_assert(N < NUM_PORTS, "invalid port");
+	return PRT_VALUE + N * 0x04;
+}
+
+template<unsigned N>
+constexpr std::uint32_t mfc_cnt() {
+	static_assert(N < NUM_ENCS, "invalid encoder channel");
+	return MFC_CNT + N * 0x40;
+}
+
+template<unsigned N>
+constexpr std::uint32_t mfc_dcr() {
+	static_assert(N < NUM_ENCS, "invalid encoder channel");
+	return MFC_DCR + N * 0x40;
+}
+
+/* MFC_DCR value of the counter modes 1x, 2x and 4x */
+template<unsigned Mode>
+constexpr std::uint32_t mfc_mode() {
+	static_assert(Mode == 1 || Mode == 2 || Mode == 4,
+			"invalid counter mode");
+	return Mode == 1 ? 0x00020080 : Mode == 2 ? 0x00060090 : 0x00069096;
+}
+
+} /* namespace reg */
+
+/**
+ * dac - DAC channel N of a board
+ *
+ * Assigning writes the DAC register, the output changes with
+ * board::dac_update.
+ */
+template<unsigned N>
+class dac {
+public:
+	explicit dac(idmf_board *board) : board_(board) {
+	}
+
+	dac & operator=(__s16 value) {
+		write(value);
+		return *this;
+	}
+
+	/* returns 0 or a negative error code, see idmf_dac_write */
+	int write(__s16 value) {
+		return idmf_reg_write(board_, reg::dac_value<N>(), (__u32) value);
+	}
+
+	__s16 read() const {
+		return (__s16) idmf_reg_read(board_, reg::dac_value<N>());
+	}
+
+private:
+	idmf_board *board_;
+};
+
+/**
+ * enc - encoder channel N of a board
+ */
+template<unsigned N>
+class enc {
+public:
+	explicit enc(idmf_board *board) : board_(board) {
+	}
+
+	std::int32_t read() const {
+		return (std::int32_t) idmf_reg_read(board_, reg::mfc_cnt<N>());
+	}
+
+	void write(std::int32_t value) {
+		idmf_reg_write(board_, reg::mfc_cnt<N>(), (__u32) value);
+	}
+
+	template<unsigned Mode>
+	void config() {
+		idmf_reg_write(board_, reg::mfc_dcr<N>(), reg::mfc_mode<Mode>());
+	}
+
+private:
+	idmf_board *board_;
+};
+
+/**
+ * port - data port N of a board
+ *
+ * Writes keep the port value used by idmf_port_write up to date.
+ */
+template<unsigned N>
+class port {
+public:
+	explicit port(idmf_board *board) : board_(board) {
+	}
+
+	std::uint8_t read() const {
+		return (std::uint8_t) idmf_reg_read(board_, reg::prt_value<N>());
+	}
+
+	port & operator=(std::uint8_t value) {
+		write(value);
+		return *this;
+	}
+
+	/* returns 0 or a negative error code, see idmf_port_write */
+	int write(std::uint8_t value) {
+		int err = idmf_reg_write(board_, reg::prt_value<N>(), value);
+
+		if (!err)
+			board_->port_values[N] = value;
+
+		return err;
+	}
+
+	template<unsigned C>
+	bool bit() const {
+		static_assert(C < NUM_PORT_CHANNELS, "invalid port channel");
+		return (read() >> C) & 0x01;
+	}
+
+	/* changes the channel atomically, see idmf_port_bits */
+	template<unsigned C>
+	int bit(bool value) {
+		static_assert(C < NUM_PORT_CHANNELS, "invalid port channel");
+		return idmf_port_bits(board_, N, value ? 1 << C : 0,
+				value ? 0 : 1 << C, 0);
+	}
+
+	template<unsigned C>
+	int toggle() {
+		static_assert(C < NUM_PORT_CHANNELS, "invalid port channel");
+		return idmf_port_bits(board_, N, 0, 0, 1 << C);
+	}
+
+private:
+	idmf_board *board_;
+};
+
+class batch;
+
+/**
+ * board - owner of an open board
+ *
+ * The board is closed by the destructor. Boards can be moved but not
+ * copied. Opening does not throw, check the board with valid().
+ */
+class board {
+public:
+	explicit board(const char *name, int flags = 0) :
+			board_(idmf_open_ex(name, flags)) {
+	}
+
+	board(board &&other) noexcept : board_(std::exchange(other.board_, nullptr)) {
+	}
+
+	board & operator=(board &&other) noexcept {
+		if (this != &other) {
+			close();
+			board_ = std::exchange(other.board_, nullptr);
+		}
+		return *this;
+	}
+
+	board(const board &) = delete;
+	board & operator=(const board &) = delete;
+
+	~board() {
+		close();
+	}
+
+	bool valid() const {
+		return board_ != nullptr;
+	}
+
+	explicit operator bool() const {
+		return valid();
+	}
+
+	/* the underlying C board for the idmf_* functions */
+	idmf_board * get() const {
+		return board_;
+	}
+
+	void close() {
+		if (board_)
+			idmf_close(std::exchange(board_, nullptr));
+	}
+
+	template<unsigned N>
+	idmf::dac<N> dac() {
+		return idmf::dac<N>(board_);
+	}
+
+	void dac_update() {
+		idmf_reg_write(board_, reg::dac_conf, reg::dac_latch);
+	}
+
+	template<unsigned N>
+	idmf::enc<N> enc() {
+		return idmf::enc<N>(board_);
+	}
+
+	template<unsigned N>
+	idmf::port<N> port() {
+		return idmf::port<N>(board_);
+	}
+
+	/* converts all ADC channels, read them with adc<N>() */
+	int adc_update() {
+		return idmf_adc_update(board_);
+	}
+
+	/* starts a conversion and returns, see idmf_adc_submit */
+	int adc_submit() {
+		return idmf_adc_submit(board_, nullptr);
+	}
+
+	/* collects the submitted conversion for adc<N>() */
+	int adc_complete(__s64 timeout = 0) {
+		return idmf_adc_complete(board_, timeout, nullptr, nullptr);
+	}
+
+	template<unsigned N>
+	__s16 adc() const {
+		static_assert(N < NUM_ADCS, "invalid ADC channel");
+		return board_->adc_values[N];
+	}
+
+	std::uint32_t gpio() const {
+		return idmf_reg_read(board_, reg::gpio_in);
+	}
+
+	int gpio(std::uint32_t values) {
+		int err = idmf_reg_write(board_, reg::gpio_out, values);
+
+		if (!err)
+			board_->gpio_values = values;
+
+		return err;
+	}
+
+	int gpio_bits(std::uint32_t set, std::uint32_t clear,
+			std::uint32_t toggle = 0) {
+		return idmf_gpio_bits(board_, set, clear, toggle);
+	}
+
+	void led(bool on) {
+		idmf_reg_write(board_, reg::bct_led, on ? 0x0001 : 0);
+	}
+
+	int snapshot(struct idmf_snapshot &snap) {
+		return ::idmf_snapshot(board_, &snap);
+	}
+
+	int commit(const struct idmf_out_frame &frame) {
+		return idmf_output_commit(board_, &frame);
+	}
+
+	inline idmf::batch batch();
+
+private:
+	idmf_board *board_;
+};
+
+/**
+ * batch - builder of a register transaction
+ *
+ *	board.batch().dac<0>(a).dac<1>(b).dac_update()
+ *			.enc<0>(count).gpio(inputs).flush();
+ *
+ * All operations are executed by flush in a single driver call. Reads store
+ * their values to the given references during the flush. The first error,
+ * such as a full transaction, is kept and returned by flush.
+ */
+class batch {
+public:
+	explicit batch(idmf_board *board) : err_(0) {
+		idmf_batch_init(&batch_, board);
+	}
+
+	/* operations which were not flushed are dropped */
+	~batch() {
+		idmf_batch_discard(&batch_);
+	}
+
+	batch(const batch &) = delete;
+	batch & operator=(const batch &) = delete;
+
+	batch & read(std::uint32_t address, __u32 &value) {
+		return check(idmf_batch_read(&batch_, address, &value));
+	}
+
+	batch & write(std::uint32_t address, __u32 value) {
+		return check(idmf_batch_write(&batch_, address, value));
+	}
+
+	template<unsigned N>
+	batch & dac(__s16 value) {
+		return write(reg::dac_value<N>(), (__u32) value);
+	}
+
+	batch & dac_update() {
+		return write(reg::dac_conf, reg::dac_latch);
+	}
+
+	template<unsigned N>
+	batch & enc(__s32 &value) {
+		return read(reg::mfc_cnt<N>(), reinterpret_cast<__u32 &>(value));
+	}
+
+	template<unsigned N>
+	batch & port(__u8 &value) {
+		static_assert(N < NUM_PORTS, "invalid port");
+		return check(idmf_batch_port_read(&batch_, N, &value));
+	}
+
+	batch & gpio(__u32 &values) {
+		return read(reg::gpio_in, values);
+	}
+
+	/* queues the read back of the ADC samples, see idmf_batch_adc_acquire */
+	batch & adc_acquire() {
+		return check(idmf_batch_adc_acquire(&batch_));
+	}
+
+	int flush() {
+		int err = err_;
+
+		if (!err)
+			err = idmf_batch_flush(&batch_);
+		else
+			idmf_batch_discard(&batch_);
+
+		err_ = 0;
+
+		return err;
+	}
+
+private:
+	batch & check(int err) {
+		if (err && !err_)
+			err_ = err;
+		return *this;
+	}
+
+	idmf_batch batch_;
+	int err_;
+};
+
+inline batch board::batch() {
+	return idmf::batch(board_);
+}
+
+} /* namespace idmf */
+
+#endif
@@ -29,10 +29,92 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
 #include <string.h>
+#include <errno.h>
 
 #include "idmf_api.h"
+#include "idmf_sim.h"
+
+#ifndef IDMF_NO_RTDM
 #include <rtdm/rtdm.h>
+#endif
+
+/*****************************************************************************/
+/* RTDM transport */
+
+#ifndef IDMF_NO_RTDM
+
+static int rtdm_transport_open(idmf_board *board) {
+	struct idmf_mmap map;
+	int err;
+
+	board->handle = rt_dev_open(board->DeviceName, 0);
+	if (board->handle < 0)
+		return board->handle;
+
+	if (board->flags & IDMF_OPEN_MMAP) {
+		err = rt_dev_ioctl(board->handle, IDMF_RTIOC_MMAP_REGS, &map);
+		if (err) {
+			rt_dev_close(board->handle);
+			return err;
+		}
+
+		board->regs = (volatile __u32 *) (unsigned long) map.addr;
+		board->regs_size = map.size;
+	}
+
+	return 0;
+}
+
+static int rtdm_transport_close(idmf_board *board) {
+	if (board->regs)
+		munmap((void *) board->regs, board->regs_size);
+
+	return rt_dev_close(board->handle);
+}
+
+static __u32 rtdm_transport_reg_read(idmf_board *board, __u32 address) {
+	__u32 value = 0;
+
+	rt_dev_ioctl(board->handle, REG_READ | address, &value);
+
+	return value;
+}
+
+static int rtdm_transport_reg_write(idmf_board *board, __u32 address,
+		__u32 value) {
+	return rt_dev_ioctl(board->handle, REG_WRITE | address, &value);
+}
+
+static int rtdm_transport_ioctl(idmf_board *board, unsigned int request,
+		void *arg) {
+	return rt_dev_ioctl(board->handle, request, arg);
+}
+
+static int rtdm_transport_read(idmf_board *board, void *buf, __u32 size) {
+	return rt_dev_read(board->handle, buf, size);
+}
+
+static const idmf_transport idmf_rtdm_transport = {
+	.name = "rtdm",
+	.open = rtdm_transport_open,
+	.close = rtdm_transport_close,
+	.reg_read = rtdm_transport_reg_read,
+	.reg_write = rtdm_transport_reg_write,
+	.ioctl = rtdm_transport_ioctl,
+	.read = rtdm_transport_read,
+};
+
+#endif
+
+static inline int board_ioctl(idmf_board *board, unsigned int request,
+		void *arg) {
+	if (!board->transport->ioctl)
+		return -ENOTTY;
+
+	return board->transport->ioctl(board, request, arg);
+}
 
 /*****************************************************************************/
 /* open/close board */
@@ -47,23 +129,67 @@
  * The function either returns the board board or a negative error code.
  */
 idmf_board * idmf_open(const char * nDeviceName) {
+	return idmf_open_ex(nDeviceName, 0);
+}
+
+/**
+ * idmf_open_ex - open an IntelliDAQ Multi-Function board
+ * @devname:	name of the char device file representing the board
+ * @flags:	IDMF_OPEN_* flags
+ *
+ * With IDMF_OPEN_MMAP the register window of the board is mapped into the
+ * address space of the process and registers are accessed with plain loads
+ * and stores instead of driver calls. Other driver operations, such as
+ * idmf_adc_update, keep using the driver.
+ *
+ * Values written to configuration and output registers are shadowed by the
+ * API: writing an unchanged value is skipped and reads of such registers are
+ * served from the shadow, see idmf_shadow_resync. IDMF_OPEN_NOCACHE disables
+ * the shadow.
+ *
+ * With IDMF_OPEN_SIM the board is replaced by the in-process simulator, see
+ * idmf_sim.h. The simulator is the only transport when the API is built with
+ * IDMF_NO_RTDM.
+ *
+ * The function returns the board or NULL on failure.
+ */
+idmf_board * idmf_open_ex(const char * nDeviceName, int flags) {
 	int i;
 	int err = 0;
 
 	idmf_board * board;
 
 	board = malloc(sizeof(idmf_board));
+	if (!board)
+		return 0;
 
 	board->DeviceName = malloc(strlen(nDeviceName) + 1);
 	strcpy(board->DeviceName, nDeviceName);
 
-	board->handle = rt_dev_open(board->DeviceName, 0);
-	if (board->handle < 0) {
-		err = board->handle;
-	}
+	board->handle = -1;
+	board->flags = flags;
+	board->priv = 0;
+	board->regs = 0;
+	board->regs_size = 0;
+	board->ring = 0;
+	board->ring_size = 0;
+
+	memset(board->shadow_valid, 0, sizeof(board->shadow_valid));
+
+#ifndef IDMF_NO_RTDM
+	if (!(flags & IDMF_OPEN_SIM))
+		board->transport = &idmf_rtdm_transport;
+	else
+#endif
+		board->transport = &idmf_sim_transport;
+
+	err = board->transport->open(board);
 
-	if (err < 0)
+	if (err < 0) {
+		free(board->DeviceName);
+		free(board);
 		return 0;
+	}
 
 	for (i = 0; i < NUM_ADCS; i++)
 		board->adc_values[i] = 0;
@@ -91,7 +217,10 @@ int idmf_close(idmf_board *board) {
 
 	int err = 0;
 
-	err = rt_dev_close(board->handle);
+	if (board->ring)
+		munmap(board->ring, board->ring_size);
+
+	err = board->transport->close(board);
 
 	free(board->DeviceName);
 
@@ -100,18 +229,350 @@ int idmf_close(idmf_board *board) {
 	return err;
 }
 
-static inline void reg_write(idmf_board *board, __u32 address, __u32 value) {
-	rt_dev_ioctl(board->handle, REG_WRITE | address, &value);
+/**
+ * idmf_claim - claim resources of a board
+ * @board:	the board
+ * @claim:	the resources, set to all resources claimed through @board
+ *
+ * Claimed resources can only be written through @board, writes of other
+ * processes fail with -EACCES. Independent control loops can run as
+ * separate processes that claim the channels of their axes. Pins of a port
+ * or of GPIO_OUT owned by different processes are changed with
+ * idmf_port_bits and idmf_gpio_bits.
+ *
+ * This function returns 0, -EBUSY if a resource is claimed by another
+ * process or the register window is mapped by any process, see
+ * IDMF_OPEN_MMAP, or another negative error code.
+ */
+int idmf_claim(idmf_board *board, struct idmf_claim *claim) {
+	return board_ioctl(board, IDMF_RTIOC_CLAIM, claim);
+}
+
+/**
+ * idmf_release - release resources of a board
+ * @board:	the board
+ * @claim:	the resources, set to the resources still claimed
+ *
+ * The resources are released by idmf_close as well.
+ *
+ * This function returns 0 or a negative error code.
+ */
+int idmf_release(idmf_board *board, struct idmf_claim *claim) {
+	return board_ioctl(board, IDMF_RTIOC_RELEASE, claim);
+}
+
+/**
+ * idmf_prog_load - upload a register program
+ * @board:	the board
+ * @ops:	the operations
+ * @count:	number of operations, at most IDMF_PROG_MAX_OPS
+ *
+ * A cycle repeating the same register accesses is uploaded once and then
+ * executed by idmf_prog_run in a single driver call. The driver validates
+ * the offsets, slots and delays when the program is loaded. The program is
+ * removed by idmf_prog_unload or idmf_close.
+ *
+ * This function returns the handle of the program or a negative error code.
+ */
+int idmf_prog_load(idmf_board *board, const struct idmf_prog_op *ops,
+		int count) {
+	struct idmf_prog_load req;
+	int err;
+
+	if (count <= 0)
+		return -EINVAL;
+
+	memset(&req, 0, sizeof(req));
+	req.ops = (unsigned long) ops;
+	req.count = count;
+
+	err = board_ioctl(board, IDMF_RTIOC_PROG_LOAD, &req);
+	if (err)
+		return err;
+
+	return req.handle;
+}
+
+/**
+ * idmf_prog_unload - remove a register program
+ * @board:	the board
+ * @handle:	handle returned by idmf_prog_load
+ *
+ * This function returns 0 or a negative error code.
+ */
+int idmf_prog_unload(idmf_board *board, int handle) {
+	__u32 value = handle;
+
+	return board_ioctl(board, IDMF_RTIOC_PROG_UNLOAD, &value);
+}
+
+/**
+ * idmf_prog_run - execute a register program
+ * @board:	the board
+ * @run:	handle and input slots, receives the output slots
+ *
+ * Writes of the program bypass the register shadow of this library, call
+ * idmf_shadow_invalidate after programs writing shadowed registers.
+ *
+ * This function returns 0 or a negative error code.
+ */
+int idmf_prog_run(idmf_board *board, struct idmf_prog_run *run) {
+	return board_ioctl(board, IDMF_RTIOC_PROG_RUN, run);
+}
+
+/*****************************************************************************/
+/* register shadow */
+
+/* shadow attributes of a register */
+#define SHADOW_ELIDE	0x01	/* writing the current value has no effect */
+#define SHADOW_READ	0x02	/* reads return the value last written */
+#define SHADOW_RELOAD	0x04	/* the board reads back the value last written */
+
+static int shadow_attr(__u32 address) {
+	if (address >= DAC_VALUE && address < DAC_VALUE + NUM_DACS * 0x04)
+		return SHADOW_ELIDE | SHADOW_READ;
+
+	/* reads of ports configured as inputs return the signals */
+	if (address >= PRT_VALUE && address < PRT_VALUE + NUM_PORTS * 0x04)
+		return SHADOW_ELIDE;
+
+	if (address >= MFC_CCR && address < MFC_CCR + NUM_ENCS * 0x40)
+		address = MFC_CCR + (address - MFC_CCR) % 0x40;
+
+	switch (address) {
+	case GPIO_OUT:
+	case BCT_LED:
+		return SHADOW_ELIDE | SHADOW_READ | SHADOW_RELOAD;
+	case PRT_CTRL:
+	case ENC_PWRCTRL:
+	case GPIO_DIR0:
+	case GPIO_DIR1:
+	case BCT_PWR:
+	case MFC_DCR:
+	case MFC_PLV:
+		return SHADOW_ELIDE | SHADOW_READ;
+	}
+
+	return 0;
+}
+
+static inline int shadow_valid(idmf_board *board, __u32 address) {
+	__u32 index = address >> 2;
+
+	return board->shadow_valid[index >> 5] & (1 << (index & 31));
+}
+
+/* records a value written to or read from a register */
+static inline void shadow_store(idmf_board *board, __u32 address,
+		__u32 value) {
+	__u32 index = address >> 2;
+
+	if ((board->flags & IDMF_OPEN_NOCACHE) || !shadow_attr(address))
+		return;
+
+	board->shadow[index] = value;
+	board->shadow_valid[index >> 5] |= 1 << (index & 31);
+}
+
+static inline void shadow_forget(idmf_board *board, __u32 address) {
+	__u32 index = address >> 2;
+
+	board->shadow_valid[index >> 5] &= ~(1 << (index & 31));
+}
+
+/* checks whether writing value to a register can be skipped */
+static inline int shadow_elide(idmf_board *board, __u32 address,
+		__u32 value) {
+	return shadow_valid(board, address)
+			&& (shadow_attr(address) & SHADOW_ELIDE)
+			&& board->shadow[address >> 2] == value;
+}
+
+/* gets the value of a register from the shadow */
+static inline int shadow_lookup(idmf_board *board, __u32 address,
+		__u32 *value) {
+	if (!shadow_valid(board, address)
+			|| !(shadow_attr(address) & SHADOW_READ))
+		return 0;
+
+	*value = board->shadow[address >> 2];
+
+	return 1;
+}
+
+/* register access bypassing the shadow */
+static inline int reg_write_raw(idmf_board *board, __u32 address,
+		__u32 value) {
+	if (board->regs) {
+		board->regs[address >> 2] = value;
+		return 0;
+	}
+
+	return board->transport->reg_write(board, address, value);
+}
+
+static inline __u32 reg_read_raw(idmf_board *board, __u32 address) {
+	if (board->regs)
+		return board->regs[address >> 2];
+
+	return board->transport->reg_read(board, address);
+}
+
+/* a rejected write leaves the register and its shadow unchanged */
+static inline int reg_write(idmf_board *board, __u32 address, __u32 value) {
+	int err;
+
+	if (shadow_elide(board, address, value))
+		return 0;
+
+	err = reg_write_raw(board, address, value);
+	if (err)
+		return err;
+
+	shadow_store(board, address, value);
+
+	return 0;
 }
 
 static inline __u32 reg_read(idmf_board *board, __u32 address) {
-	__u32 value = 0;
+	__u32 value;
 
-	rt_dev_ioctl(board->handle, REG_READ | address, &value);
+	if (shadow_lookup(board, address, &value))
+		return value;
+
+	value = reg_read_raw(board, address);
+	if (shadow_attr(address) & SHADOW_RELOAD)
+		shadow_store(board, address, value);
 
 	return value;
 }
 
+/*
+ * Applies bit masks to PRT_VALUE or GPIO_OUT in the driver. Transports
+ * without IDMF_RTIOC_BIT_OP fall back to the values last written by this
+ * process.
+ */
+static int bit_op(idmf_board *board, __u32 target, __u32 set, __u32 clear,
+		__u32 toggle, __u32 *value) {
+	struct idmf_bit_op op;
+	__u32 address, prev, mask;
+	int err;
+
+	if (target < NUM_PORTS) {
+		address = PRT_VALUE + target * 0x04;
+		prev = board->port_values[target];
+		mask = 0xFF;
+	} else {
+		address = GPIO_OUT;
+		prev = board->gpio_values;
+		mask = 0xFFFFFFFF;
+	}
+
+	memset(&op, 0, sizeof(op));
+	op.target = target;
+	op.set = set;
+	op.clear = clear;
+	op.toggle = toggle;
+
+	err = board_ioctl(board, IDMF_RTIOC_BIT_OP, &op);
+	if (err == -ENOTTY) {
+		op.value = (((prev | set) & ~clear) ^ toggle) & mask;
+		err = reg_write(board, address, op.value);
+		if (err)
+			return err;
+	} else if (err)
+		return err;
+	else
+		shadow_store(board, address, op.value);
+
+	*value = op.value;
+
+	return 0;
+}
+
+/**
+ * idmf_reg_read - read a register
+ * @board:	the board
+ * @address:	the register offset, a multiple of 4 within the register window
+ *
+ * Reads of shadowed registers are served from the shadow.
+ *
+ * This function returns the register value or 0 for an invalid offset.
+ */
+__u32 idmf_reg_read(idmf_board *board, __u32 address) {
+	if ((address & 0x03) || address >= IDMF_REG_WINDOW)
+		return 0;
+
+	return reg_read(board, address);
+}
+
+/**
+ * idmf_reg_write - write a register
+ * @board:	the board
+ * @address:	the register offset, a multiple of 4 within the register window
+ * @value:	the value
+ *
+ * Writes of unchanged values to shadowed registers are skipped.
+ *
+ * This function returns 0 or a negative error code, -EACCES when the
+ * register belongs to a resource claimed by another file.
+ */
+int idmf_reg_write(idmf_board *board, __u32 address, __u32 value) {
+	if ((address & 0x03) || address >= IDMF_REG_WINDOW)
+		return -EINVAL;
+
+	return reg_write(board, address, value);
+}
+
+/**
+ * idmf_shadow_invalidate - forget all shadowed register values
+ * @board:	the board
+ *
+ * This function has to be called when the registers of the board may have
+ * been changed by another process or through the driver. The following
+ * accesses go to the board until the values are known again.
+ */
+void idmf_shadow_invalidate(idmf_board *board) {
+	memset(board->shadow_valid, 0, sizeof(board->shadow_valid));
+}
+
+/**
+ * idmf_shadow_resync - reload the shadowed register values from the board
+ * @board:	the board
+ *
+ * The registers which read back the value last written are reloaded within
+ * a single driver call. The others stay unknown until they are written
+ * again, reading them back would not return their setting. The port values
+ * are not read back either, since ports configured as inputs return their
+ * signals. The GPIO values used by idmf_gpio_write are updated.
+ *
+ * This function returns 0 or a negative error code.
+ */
+int idmf_shadow_resync(idmf_board *board) {
+	idmf_batch batch;
+	__u32 address;
+	int err;
+
+	idmf_shadow_invalidate(board);
+
+	idmf_batch_init(&batch, board);
+
+	for (address = 0; address < IDMF_REG_WINDOW; address += 0x04)
+		if (shadow_attr(address) & SHADOW_RELOAD) {
+			err = idmf_batch_read(&batch, address, NULL);
+			if (err)
+				return err;
+		}
+
+	err = idmf_batch_flush(&batch);
+	if (err)
+		return err;
+
+	board->gpio_values = reg_read(board, GPIO_OUT);
+
+	return 0;
+}
+
 static inline void serial_write(idmf_board *board, __u32 value) {
 	int i;
 
@@ -171,27 +632,67 @@ __s16 idmf_dac_read(idmf_board *board, int channel) {
  * This function writes the specified value to the specified DAC register.
  * This value does not change the output of the DAC until idmf_dac_update is 
  * called.
+ *
+ * This function returns 0 or a negative error code, -EACCES when the DAC is
+ * claimed by another file.
  */
-void idmf_dac_write(idmf_board *board, int channel, __s16 value) {
+int idmf_dac_write(idmf_board *board, int channel, __s16 value) {
 	if ((channel < 0) || (channel >= NUM_DACS))
-		return;
+		return -EINVAL;
 
-	reg_write(board, DAC_VALUE + channel * 0x04, (__u32 ) value);
+	return reg_write(board, DAC_VALUE + channel * 0x04, (__u32 ) value);
 }
 
 /*****************************************************************************/
 /* ADC functions */
 
+/*
+ * A reference configuration shifts two serial words, which takes well below
+ * a millisecond. Its owner may have been preempted, so the wait is bounded.
+ */
+#define ADC_REF_POLL_US		10
+#define ADC_REF_WAIT_US		1000
+
 /**
  * idmf_adc_config - configure the on-board analog reference
  * @board:	the board
  * @refadc:	reference voltage of ADC (5.0 V / 65535)
  * @refina:	reference voltage of INA (5.0 V / 65535)
+ *
+ * The serial words are shifted into the reference by the driver within a
+ * single call. The driver remembers the programmed values, so configuring
+ * the same references again does not access the board. A call overlapping
+ * the configuration of another thread or process is retried once that one
+ * has finished, for about a millisecond.
+ *
+ * This function returns 0 or a negative error code, -EBUSY when the other
+ * configuration did not finish in time.
  */
-void idmf_adc_config(idmf_board *board, __u16 refadc, __u16 refina) {
+int idmf_adc_config(idmf_board *board, __u16 refadc, __u16 refina) {
+	struct idmf_adc_ref ref;
+	int waited = 0;
+	int err;
+
+	memset(&ref, 0, sizeof(ref));
+	ref.refadc = refadc;
+	ref.refina = refina;
+
+	while ((err = board_ioctl(board, IDMF_RTIOC_ADC_REF, &ref)) == -EBUSY) {
+		if (waited >= ADC_REF_WAIT_US)
+			return -EBUSY;
+
+		usleep(ADC_REF_POLL_US);
+		waited += ADC_REF_POLL_US;
+	}
+
+	if (err != -ENOTTY)
+		return err;
+
 	reg_write(board, ADC_DATA, 0x0C);
 	serial_write(board, 0x00100000 | refina);
 	serial_write(board, 0x00240000 | refadc);
+
+	return 0;
 }
 
 /**
@@ -215,46 +716,115 @@ void idmf_adc_run(idmf_board *board) {
  * @board:	the board
  */
 void idmf_adc_acquire(idmf_board *board) {
-	board->adc_values[5] = reg_read(board, ADC_DATA);
-	board->adc_values[4] = reg_read(board, ADC_DATA);
-	board->adc_values[1] = reg_read(board, ADC_DATA);
-	board->adc_values[0] = reg_read(board, ADC_DATA);
-	board->adc_values[3] = reg_read(board, ADC_DATA);
-	board->adc_values[2] = reg_read(board, ADC_DATA);
-	board->adc_values[7] = reg_read(board, ADC_DATA);
-	board->adc_values[6] = reg_read(board, ADC_DATA);
+	idmf_batch batch;
+
+	idmf_batch_init(&batch, board);
+	idmf_batch_adc_acquire(&batch);
+	idmf_batch_flush(&batch);
 }
 
 /**
  * idmf_adc_update - acquire and convert sample
  *
- * It is strongly not advised to use this function
- * inside RTDM task context!
+ * The whole conversion sequence, including the waits required by the
+ * hardware, is executed by the driver within a single call. It is safe
+ * to use this function inside RTDM task context. A conversion started by
+ * idmf_adc_submit is completed first.
+ *
+ * @board:	the board
  *
- * Instead use:
+ * This function returns 0 or a negative error code, board->adc_values are
+ * left unchanged on failure.
+ */
+int idmf_adc_update(idmf_board *board) {
+	struct idmf_adc_frame frame;
+	int i;
+	int err;
+
+	err = board_ioctl(board, IDMF_RTIOC_ADC_CONVERT, &frame);
+
+	if (err == -ENOTTY) {
+		idmf_adc_request(board);
+		usleep(1);
+		idmf_adc_run(board);
+		usleep(3);
+		idmf_adc_acquire(board);
+		return 0;
+	}
+
+	if (err)
+		return err;
+
+	for (i = 0; i < NUM_ADCS; i++)
+		board->adc_values[i] = frame.value[i];
+
+	return 0;
+}
+
+/**
+ * idmf_adc_submit - start an asynchronous ADC conversion
+ * @board:	the board
+ * @seq:	set to the sequence number of the conversion, may be NULL
  *
- * idmf_adc_request()
- * rtdm_task_sleep() <- sleep in nanoseconds
- * idmf_adc_run()
- * rtdm_task_sleep() <- sleep in nanoseconds
- * idmf_adc_update()
+ * The function returns as soon as the conversion is requested, the driver
+ * finishes it in the background. The caller can do other work during the
+ * conversion time and collect the samples with idmf_adc_complete.
+ * Synchronous conversions of the board wait while the conversion runs.
  *
+ * This function returns 0, -EBUSY if a conversion is in progress or
+ * another negative error code.
+ */
+int idmf_adc_submit(idmf_board *board, __u32 *seq) {
+	__u32 value;
+	int err;
+
+	err = board_ioctl(board, IDMF_RTIOC_ADC_SUBMIT, &value);
+	if (err)
+		return err;
+
+	if (seq)
+		*seq = value;
+
+	return 0;
+}
+
+/**
+ * idmf_adc_complete - wait for an asynchronous ADC conversion
  * @board:	the board
+ * @timeout:	timeout in nanoseconds, 0 waits infinitely and a negative
+ *		value does not wait at all
+ * @frame:	set to the samples, may be NULL
+ * @seq:	set to the sequence number of the samples, may be NULL
+ *
+ * The function waits for the conversion last submitted through @board. The
+ * samples are also stored for idmf_adc_read, as by idmf_adc_update.
+ *
+ * This function returns 0, -EWOULDBLOCK if the conversion is still running
+ * and @timeout is negative, or another negative error code.
  */
-void idmf_adc_update(idmf_board *board) {
-	reg_write(board, BCT_ADC, 0x01);
-	usleep(1);
-	reg_write(board, BCT_ADC, 0x00);
-	usleep(3);
+int idmf_adc_complete(idmf_board *board, __s64 timeout,
+		struct idmf_adc_frame *frame, __u32 *seq) {
+	struct idmf_adc_wait req;
+	int err;
+	int i;
+
+	memset(&req, 0, sizeof(req));
+	req.timeout = timeout;
+
+	err = board_ioctl(board, IDMF_RTIOC_ADC_WAIT, &req);
+	if (err)
+		return err;
+
+	for (i = 0; i < NUM_ADCS; i++)
+		board->adc_values[i] = req.frame.value[i];
+
+	if (frame)
+		*frame = req.frame;
 
-	board->adc_values[5] = reg_read(board, ADC_DATA);
-	board->adc_values[4] = reg_read(board, ADC_DATA);
-	board->adc_values[1] = reg_read(board, ADC_DATA);
-	board->adc_values[0] = reg_read(board, ADC_DATA);
-	board->adc_values[3] = reg_read(board, ADC_DATA);
-	board->adc_values[2] = reg_read(board, ADC_DATA);
-	board->adc_values[7] = reg_read(board, ADC_DATA);
-	board->adc_values[6] = reg_read(board, ADC_DATA);
+	if (seq)
+		*seq = req.seq;
+
+	return 0;
 }
 
 /**
@@ -337,24 +907,57 @@ __u8 idmf_port_read(idmf_board *board, int port, int channel) {
  * This function writes the specified value to the specified DAC register. If
  * the port is configured as an input, the value on the port does not change
  * until the port is configured as an output by calling idmf_port_config.
+ *
+ * This function returns 0 or a negative error code, see idmf_port_bits.
  */
-void idmf_port_write(idmf_board *board, int port, int channel, __u8 value) {
+int idmf_port_write(idmf_board *board, int port, int channel, __u8 value) {
+	__u8 bit;
+
 	if (!board)
-		return;
+		return -EINVAL;
 
 	if ((port < 0) || (port >= NUM_PORTS))
-		return;
+		return -EINVAL;
 
 	if ((channel < -1) || (channel >= NUM_PORT_CHANNELS))
-		return;
+		return -EINVAL;
 	else if (channel == -1)
-		board->port_values[port] = value;
-	else
-		board->port_values[port] =
-				(board->port_values[port] & (~(1 << channel)))
-						| ((value ? 1 : 0) << channel);
+		return idmf_port_bits(board, port, value, (__u8) ~value, 0);
+
+	bit = 1 << channel;
+
+	return idmf_port_bits(board, port, value ? bit : 0, value ? 0 : bit, 0);
+}
+
+/**
+ * idmf_port_bits - set, clear and toggle bits of a data port
+ * @board:	the board
+ * @port:	the port on the board
+ * @set:	channels to be set
+ * @clear:	channels to be cleared
+ * @toggle:	channels to be inverted, applied after @set and @clear
+ *
+ * The bits are changed atomically by the driver, so several processes may
+ * drive different channels of a port. The resulting value is stored in
+ * board->port_values.
+ *
+ * This function returns 0 or a negative error code.
+ */
+int idmf_port_bits(idmf_board *board, int port, __u8 set, __u8 clear,
+		__u8 toggle) {
+	__u32 value;
+	int err;
+
+	if ((port < 0) || (port >= NUM_PORTS))
+		return -EINVAL;
+
+	err = bit_op(board, IDMF_BITS_PORT(port), set, clear, toggle, &value);
+	if (err)
+		return err;
 
-	reg_write(board, PRT_VALUE + port * 0x04, board->port_values[port]);
+	board->port_values[port] = (__u8) value;
+
+	return 0;
 }
 
 /*****************************************************************************/
@@ -405,20 +1008,48 @@ __u32 idmf_gpio_read(idmf_board *board, int channel) {
  * A zero bit denotes a low signal; a one bit denotes a high signal. If a pin
  * is configured as an input, the value on the pin does not change until the
  * pin is configured as an output by calling idmf_gpio_config.
+ *
+ * This function returns 0 or a negative error code, see idmf_gpio_bits.
  */
-void idmf_gpio_write(idmf_board *board, int channel, __u32 values) {
+int idmf_gpio_write(idmf_board *board, int channel, __u32 values) {
+	__u32 bit;
+
 	if (!board)
-		return;
+		return -EINVAL;
 
 	if ((channel < -1) || (channel >= NUM_GPIOS))
-		return;
+		return -EINVAL;
 	else if (channel == -1)
-		board->gpio_values = values;
-	else
-		board->gpio_values = (board->gpio_values & (~(1 << channel)))
-				| ((values ? 1 : 0) << channel);
+		return idmf_gpio_bits(board, values, ~values, 0);
+
+	bit = 1 << channel;
+
+	return idmf_gpio_bits(board, values ? bit : 0, values ? 0 : bit, 0);
+}
+
+/**
+ * idmf_gpio_bits - set, clear and toggle general-purpose outputs
+ * @board:	the board
+ * @set:	pins to be set
+ * @clear:	pins to be cleared
+ * @toggle:	pins to be inverted, applied after @set and @clear
+ *
+ * The bits are changed atomically by the driver, so several processes may
+ * drive different pins. The resulting value is stored in board->gpio_values.
+ *
+ * This function returns 0 or a negative error code.
+ */
+int idmf_gpio_bits(idmf_board *board, __u32 set, __u32 clear, __u32 toggle) {
+	__u32 value;
+	int err;
+
+	err = bit_op(board, IDMF_BITS_GPIO, set, clear, toggle, &value);
+	if (err)
+		return err;
+
+	board->gpio_values = value;
 
-	reg_write(board, GPIO_OUT, board->gpio_values);
+	return 0;
 }
 
 /*****************************************************************************/
@@ -493,6 +1124,44 @@ void idmf_enc_write(idmf_board *board, int channel, __s32 value) {
 	reg_write(board, MFC_CNT + channel * 0x40, (__u32 ) value);
 }
 
+/**
+ * idmf_enc_track_config - set the velocity window of the encoder tracking
+ * @board:	the board
+ * @window_ns:	velocity window in nanoseconds, 0 selects IDMF_ENC_WINDOW_NS
+ *
+ * The driver extends the encoder counts it reads for the acquisition and
+ * for snapshots to 64 bit positions and derives their velocity, see struct
+ * idmf_enc_track. All channels are restarted at their next reading.
+ *
+ * This function returns 0 or a negative error code.
+ */
+int idmf_enc_track_config(idmf_board *board, __u64 window_ns) {
+	struct idmf_enc_track track;
+
+	memset(&track, 0, sizeof(track));
+	track.flags = IDMF_ENC_TRACK_CONFIG;
+	track.window_ns = window_ns;
+
+	return board_ioctl(board, IDMF_RTIOC_ENC_TRACK, &track);
+}
+
+/**
+ * idmf_enc_track_read - get the tracked encoder positions and velocities
+ * @board:	the board
+ * @track:	the state at the last reading of each channel
+ *
+ * The state is not refreshed by this call, the encoders are read by the
+ * acquisition or by idmf_snapshot. Samples of the acquisition carry the
+ * state of their own reading in enc_pos and enc_vel.
+ *
+ * This function returns 0 or a negative error code.
+ */
+int idmf_enc_track_read(idmf_board *board, struct idmf_enc_track *track) {
+	memset(track, 0, sizeof(*track));
+
+	return board_ioctl(board, IDMF_RTIOC_ENC_TRACK, track);
+}
+
 /*****************************************************************************/
 /* led function */
 
@@ -507,3 +1176,840 @@ void idmf_led_write(idmf_board *board, __u32 value) {
 void idmf_led_read(idmf_board *board, __u32 * value) {
 	*value = reg_read(board, BCT_LED);
 }
+
+/*****************************************************************************/
+/* acquisition functions */
+
+/**
+ * idmf_acq_start - start the periodic acquisition of the driver
+ * @board:	the board
+ * @config:	sampling period, ring size and sources to be sampled
+ *
+ * The driver samples the selected inputs from a realtime task at a fixed
+ * rate into a ring, which is drained with idmf_acq_read. There is one
+ * acquisition per board, shared by all processes which opened it.
+ *
+ * This function returns 0 or a negative error code.
+ */
+int idmf_acq_start(idmf_board *board, const struct idmf_acq_config *config) {
+	return board_ioctl(board, IDMF_RTIOC_ACQ_START, (void *) config);
+}
+
+/**
+ * idmf_acq_stop - stop the periodic acquisition
+ * @board:	the board
+ *
+ * Samples still held by the ring can be read afterwards.
+ */
+int idmf_acq_stop(idmf_board *board) {
+	return board_ioctl(board, IDMF_RTIOC_ACQ_STOP, 0);
+}
+
+/**
+ * idmf_acq_status - get the state of the periodic acquisition
+ * @board:	the board
+ * @status:	the state
+ *
+ * The state is taken in non-realtime context, a realtime caller is switched
+ * to secondary mode.
+ */
+int idmf_acq_status(idmf_board *board, struct idmf_acq_status *status) {
+	return board_ioctl(board, IDMF_RTIOC_ACQ_STATUS, status);
+}
+
+/**
+ * idmf_acq_read - read samples of the periodic acquisition
+ * @board:	the board
+ * @samples:	the buffer
+ * @count:	number of samples to be read
+ *
+ * This function blocks until @count samples are available or the timeout of
+ * the acquisition expires. There is a single reader per board at a time.
+ *
+ * This function returns the number of samples read or a negative error code,
+ * -EBUSY while another thread or process is reading.
+ */
+int idmf_acq_read(idmf_board *board, struct idmf_sample *samples, int count) {
+	int ret;
+
+	if (!board->transport->read)
+		return -ENOSYS;
+
+	if (count <= 0)
+		return -EINVAL;
+
+	ret = board->transport->read(board, samples,
+			count * sizeof(struct idmf_sample));
+
+	if (ret < 0)
+		return ret;
+
+	return ret / sizeof(struct idmf_sample);
+}
+
+/**
+ * idmf_adc_accum - read the ADC accumulators of the acquisition
+ * @board:	the board
+ * @flags:	IDMF_ACCUM_RESET clears the accumulators once they are read
+ * @accum:	the accumulated conversions
+ *
+ * With oversampling, see struct idmf_acq_config, the acquisition task runs
+ * several conversions per period. Reading the accumulators once per control
+ * cycle with IDMF_ACCUM_RESET returns all conversions since the last cycle
+ * in a single driver call.
+ *
+ * This function returns 0 or a negative error code.
+ */
+int idmf_adc_accum(idmf_board *board, __u32 flags,
+		struct idmf_adc_accum *accum) {
+	memset(accum, 0, sizeof(*accum));
+	accum->flags = flags;
+
+	return board_ioctl(board, IDMF_RTIOC_ADC_ACCUM, accum);
+}
+
+/**
+ * idmf_mon_start - start the edge monitor
+ * @board:	the board
+ * @config:	the configuration
+ *
+ * The driver samples the monitored GPIO and port pins periodically, on
+ * counter interrupts or both, and queues their edges. This replaces polling
+ * idmf_gpio_read and idmf_port_read from user space. The pins themselves do
+ * not interrupt, see struct idmf_mon_config.
+ *
+ * This function returns 0 or a negative error code.
+ */
+int idmf_mon_start(idmf_board *board, const struct idmf_mon_config *config) {
+	return board_ioctl(board, IDMF_RTIOC_MON_START, (void *) config);
+}
+
+/**
+ * idmf_mon_stop - stop the edge monitor
+ * @board:	the board
+ *
+ * Events still queued can be read afterwards.
+ */
+int idmf_mon_stop(idmf_board *board) {
+	return board_ioctl(board, IDMF_RTIOC_MON_STOP, 0);
+}
+
+/**
+ * idmf_mon_read - read the events of the edge monitor
+ * @board:	the board
+ * @events:	the buffer
+ * @count:	capacity of @events
+ * @timeout:	timeout in nanoseconds, 0 waits infinitely and a negative
+ *		value does not wait at all
+ * @lost:	set to the number of events dropped on a full queue since the
+ *		previous read, may be NULL
+ *
+ * This function blocks until at least one event is queued. There is a single
+ * reader per board at a time.
+ *
+ * This function returns the number of events read or a negative error code,
+ * -EBUSY while another thread or process is reading.
+ */
+int idmf_mon_read(idmf_board *board, struct idmf_mon_event *events, int count,
+		__s64 timeout, __u32 *lost) {
+	struct idmf_mon_read req;
+	int err;
+
+	if (count <= 0)
+		return -EINVAL;
+
+	memset(&req, 0, sizeof(req));
+	req.events = (unsigned long) events;
+	req.timeout = timeout;
+	req.count = count;
+
+	err = board_ioctl(board, IDMF_RTIOC_MON_READ, &req);
+	if (err)
+		return err;
+
+	if (lost)
+		*lost = req.lost;
+
+	return req.count;
+}
+
+/**
+ * idmf_ring_map - map the sample ring of the acquisition
+ * @board:	the board
+ *
+ * After the mapping, samples are consumed in place with idmf_ring_peek and
+ * idmf_ring_commit without driver calls. The acquisition has to be started
+ * before. The ring is unmapped by idmf_close.
+ *
+ * This function returns 0 or a negative error code.
+ */
+int idmf_ring_map(idmf_board *board) {
+	struct idmf_mmap map;
+	int err;
+
+	if (board->ring)
+		return 0;
+
+	err = board_ioctl(board, IDMF_RTIOC_ACQ_MMAP, &map);
+	if (err)
+		return err;
+
+	board->ring = (struct idmf_ring *) (unsigned long) map.addr;
+	board->ring_size = map.size;
+
+	return 0;
+}
+
+/**
+ * idmf_ring_peek - get the samples ready to be consumed
+ * @board:	the board
+ * @samples:	set to the first sample
+ *
+ * The samples stay valid until they are released with idmf_ring_commit.
+ * Only samples up to the end of the ring are returned, the following ones
+ * are returned by the next call after the commit.
+ *
+ * This function returns the number of samples at @samples.
+ */
+int idmf_ring_peek(idmf_board *board, struct idmf_sample **samples) {
+	struct idmf_ring *ring = board->ring;
+	__u32 head, tail, slot;
+
+	if (!ring)
+		return 0;
+
+	head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+	tail = ring->tail;
+	slot = tail & (ring->frames - 1);
+
+	*samples = (struct idmf_sample *) ((char *) ring + ring->data_offset)
+			+ slot;
+
+	if (head - tail > ring->frames - slot)
+		return ring->frames - slot;
+
+	return head - tail;
+}
+
+/**
+ * idmf_ring_commit - release consumed samples
+ * @board:	the board
+ * @count:	number of samples consumed, at most the value of idmf_ring_peek
+ */
+void idmf_ring_commit(idmf_board *board, int count) {
+	struct idmf_ring *ring = board->ring;
+
+	if (!ring || count <= 0)
+		return;
+
+	__atomic_store_n(&ring->tail, ring->tail + count, __ATOMIC_RELEASE);
+}
+
+/**
+ * idmf_ring_wait - wait for samples
+ * @board:	the board
+ * @count:	number of samples to wait for
+ *
+ * This function enters the driver only when fewer than @count samples are
+ * available. It blocks until they are, see idmf_acq_read for the timeout.
+ *
+ * This function returns 0 or a negative error code.
+ */
+int idmf_ring_wait(idmf_board *board, int count) {
+	struct idmf_ring *ring = board->ring;
+	__u32 value = count;
+
+	if (ring && __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) - ring->tail
+			>= value)
+		return 0;
+
+	return board_ioctl(board, IDMF_RTIOC_ACQ_WAIT, &value);
+}
+
+/**
+ * idmf_irq_wait - wait for the board interrupt
+ * @board:	the board
+ * @timeout:	timeout in nanoseconds, 0 waits infinitely and a negative
+ *		value does not wait at all
+ * @flags:	IDMF_IRQ_CLEAR discards events which occurred before the call
+ * @event:	set to the interrupt sources and timestamp, may be NULL
+ *
+ * The driver has to be loaded with use_irq=1 and the caller has to be a
+ * realtime task.
+ *
+ * This function returns 0 or a negative error code, -ETIMEDOUT or
+ * -EWOULDBLOCK when no interrupt occurred.
+ */
+int idmf_irq_wait(idmf_board *board, __s64 timeout, __u32 flags,
+		struct idmf_irq_event *event) {
+	struct idmf_irq_event result;
+	int err;
+
+	memset(&result, 0, sizeof(result));
+	result.timeout = timeout;
+	result.flags = flags;
+
+	err = board_ioctl(board, IDMF_RTIOC_IRQ_WAIT, &result);
+	if (err)
+		return err;
+
+	if (event)
+		*event = result;
+
+	return 0;
+}
+
+/**
+ * idmf_snapshot - sample all inputs of a board
+ * @board:	the board
+ * @snap:	the snapshot
+ *
+ * The ADC conversion and the reads of the encoders, ports, GPIOs and encoder
+ * alarm and power status registers are executed by the driver within a
+ * single call. The ADC values are also stored in the board as with
+ * idmf_adc_update.
+ *
+ * Drivers without the snapshot request are served by a conversion and one
+ * transaction; the timestamp is 0 then.
+ *
+ * This function returns 0 or a negative error code.
+ */
+int idmf_snapshot(idmf_board *board, struct idmf_snapshot *snap) {
+	idmf_batch batch;
+	int i;
+	int err;
+
+	err = board_ioctl(board, IDMF_RTIOC_SNAPSHOT, snap);
+
+	if (err == -ENOTTY) {
+		memset(snap, 0, sizeof(*snap));
+
+		idmf_adc_update(board);
+
+		idmf_batch_init(&batch, board);
+
+		for (i = 0; i < NUM_ENCS; i++)
+			idmf_batch_enc_read(&batch, i, &snap->enc[i]);
+
+		for (i = 0; i < NUM_PORTS; i++)
+			idmf_batch_port_read(&batch, i, &snap->port[i]);
+
+		idmf_batch_gpio_read(&batch, &snap->gpio);
+		idmf_batch_read(&batch, ENC_ALARM0, &snap->enc_alarm[0]);
+		idmf_batch_read(&batch, ENC_ALARM1, &snap->enc_alarm[1]);
+		idmf_batch_read(&batch, ENC_PWRSTAT, &snap->enc_pwrstat);
+
+		err = idmf_batch_flush(&batch);
+		if (err)
+			return err;
+
+		for (i = 0; i < NUM_ADCS; i++)
+			snap->adc[i] = board->adc_values[i];
+
+		return 0;
+	}
+
+	if (err)
+		return err;
+
+	for (i = 0; i < NUM_ADCS; i++)
+		board->adc_values[i] = snap->adc[i];
+
+	return 0;
+}
+
+/**
+ * idmf_group_snapshot - sample all inputs of all boards
+ * @board:	any board of the system
+ * @frame:	the snapshots, frame->board[N] belongs to board idmfN
+ *
+ * The ADC conversions of all boards handled by the driver are started back
+ * to back and all other inputs are read while they are running, within a
+ * single driver call. All snapshots carry the same timestamp. The ADC
+ * values stored in @board are not updated.
+ *
+ * This function returns 0 or a negative error code.
+ */
+int idmf_group_snapshot(idmf_board *board, struct idmf_group_frame *frame) {
+	return board_ioctl(board, IDMF_RTIOC_GROUP_SNAPSHOT, frame);
+}
+
+/**
+ * idmf_output_commit - write the outputs of a board
+ * @board:	the board
+ * @frame:	the outputs, see struct idmf_out_frame
+ *
+ * All selected DAC values are written and latched together, followed by the
+ * ports, GPIO_OUT and BCT_LED, within a single driver call. The driver skips
+ * registers which already hold the requested value. The port and GPIO values
+ * used by idmf_port_write and idmf_gpio_write are updated accordingly.
+ *
+ * Drivers without the commit request are served by one transaction which
+ * writes all selected registers.
+ *
+ * This function returns 0 or a negative error code.
+ */
+int idmf_output_commit(idmf_board *board, const struct idmf_out_frame *frame) {
+	idmf_batch batch;
+	int i;
+	int err;
+
+	err = board_ioctl(board, IDMF_RTIOC_OUT_COMMIT, (void *) frame);
+
+	if (err == -ENOTTY) {
+		idmf_batch_init(&batch, board);
+
+		for (i = 0; i < NUM_DACS; i++)
+			if (frame->dac_mask & (1 << i))
+				idmf_batch_dac_write(&batch, i, frame->dac[i]);
+
+		if (frame->dac_mask & ((1 << NUM_DACS) - 1))
+			idmf_batch_dac_update(&batch);
+
+		for (i = 0; i < NUM_PORTS; i++)
+			if (frame->port_mask & (1 << i))
+				idmf_batch_write(&batch, PRT_VALUE + i * 0x04, frame->port[i]);
+
+		if (frame->flags & IDMF_OUT_GPIO)
+			idmf_batch_write(&batch, GPIO_OUT, frame->gpio);
+
+		if (frame->flags & IDMF_OUT_LED)
+			idmf_batch_write(&batch, BCT_LED, frame->led);
+
+		err = idmf_batch_flush(&batch);
+	}
+
+	if (err)
+		return err;
+
+	for (i = 0; i < NUM_DACS; i++)
+		if (frame->dac_mask & (1 << i))
+			shadow_store(board, DAC_VALUE + i * 0x04, (__u32) frame->dac[i]);
+
+	for (i = 0; i < NUM_PORTS; i++)
+		if (frame->port_mask & (1 << i)) {
+			board->port_values[i] = frame->port[i];
+			shadow_store(board, PRT_VALUE + i * 0x04, frame->port[i]);
+		}
+
+	if (frame->flags & IDMF_OUT_LED)
+		shadow_store(board, BCT_LED, frame->led);
+
+	if (frame->flags & IDMF_OUT_GPIO) {
+		board->gpio_values = frame->gpio;
+		shadow_store(board, GPIO_OUT, frame->gpio);
+	}
+
+	return 0;
+}
+
+/**
+ * idmf_trace_enable - turn the register access trace of the driver on or off
+ * @board:	the board
+ * @enable:	non-zero to record the register accesses of the driver
+ * @head:	set to the sequence number of the next entry, may be NULL
+ *
+ * The trace records every register access the driver issues on behalf of
+ * any caller. Accesses through a mapped register window are not recorded.
+ *
+ * This function returns 0 or a negative error code.
+ */
+int idmf_trace_enable(idmf_board *board, int enable, __u32 *head) {
+	struct idmf_trace_ctl ctl;
+	int err;
+
+	ctl.flags = enable ? IDMF_TRACE_ENABLE : 0;
+	ctl.head = 0;
+
+	err = board_ioctl(board, IDMF_RTIOC_TRACE_CTL, &ctl);
+	if (err)
+		return err;
+
+	if (head)
+		*head = ctl.head;
+
+	return 0;
+}
+
+/**
+ * idmf_trace_read - copy entries of the register access trace
+ * @board:	the board
+ * @entries:	the entries
+ * @count:	capacity of @entries
+ * @seq:	sequence number of the first entry wanted, advanced past the
+ *		entries returned
+ * @lost:	set to the number of entries overwritten before they could be
+ *		copied, may be NULL
+ *
+ * The driver keeps the last IDMF_TRACE_FRAMES entries. Reading does not
+ * stop the tracing.
+ *
+ * This function returns the number of entries copied or a negative error
+ * code.
+ */
+int idmf_trace_read(idmf_board *board, struct idmf_trace_entry *entries,
+		int count, __u32 *seq, __u32 *lost) {
+	struct idmf_trace_dump dump;
+	int err;
+
+	if (count < 0)
+		return -EINVAL;
+
+	memset(&dump, 0, sizeof(dump));
+	dump.entries = (__u64) (unsigned long) entries;
+	dump.count = count;
+	dump.start = *seq;
+
+	err = board_ioctl(board, IDMF_RTIOC_TRACE_DUMP, &dump);
+	if (err)
+		return err;
+
+	*seq = dump.start;
+
+	if (lost)
+		*lost = dump.lost;
+
+	return dump.count;
+}
+
+/*****************************************************************************/
+/* batch functions */
+
+/* order in which the board delivers the ADC channels through ADC_DATA */
+static const int adc_fifo_order[NUM_ADCS] = { 5, 4, 1, 0, 3, 2, 7, 6 };
+
+static void batch_store(void *dest, __u8 size, __u32 value) {
+	if (!dest)
+		return;
+
+	switch (size) {
+	case 1:
+		*(__u8 *) dest = (__u8 ) value;
+		break;
+	case 2:
+		*(__u16 *) dest = (__u16 ) value;
+		break;
+	case 4:
+		*(__u32 *) dest = value;
+		break;
+	}
+}
+
+/* finds the last write of a register queued in a transaction */
+static int batch_pending(idmf_batch *batch, __u32 address, __u32 *value) {
+	unsigned int i;
+
+	for (i = batch->count; i > 0; i--) {
+		if (batch->ops[i - 1].op == IDMF_OP_WRITE
+				&& batch->ops[i - 1].offset == address) {
+			*value = batch->ops[i - 1].value;
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Reads of shadowed registers are served and unchanged writes dropped at the
+ * time they are queued, taking the writes queued before them into account.
+ * The shadow only records writes once idmf_batch_flush executed them.
+ */
+static int batch_queue(idmf_batch *batch, __u32 op, __u32 address,
+		__u32 value, void *dest, __u8 size) {
+	struct idmf_reg_op *reg_op;
+	idmf_board *board = batch->board;
+	__u32 cached = 0;
+	int known;
+
+	/* the register holds a queued write once the batch has run */
+	if (batch_pending(batch, address, &cached))
+		known = !(board->flags & IDMF_OPEN_NOCACHE);
+	else if ((known = shadow_valid(board, address)))
+		cached = board->shadow[address >> 2];
+
+	if (op == IDMF_OP_READ && known
+			&& (shadow_attr(address) & SHADOW_READ)) {
+		batch_store(dest, size, cached);
+		return 0;
+	}
+
+	if (op == IDMF_OP_WRITE && known
+			&& (shadow_attr(address) & SHADOW_ELIDE) && cached == value)
+		return 0;
+
+	if (batch->count >= IDMF_XACT_MAX)
+		return -ENOSPC;
+
+	reg_op = &batch->ops[batch->count];
+	reg_op->op = op;
+	reg_op->offset = address;
+	reg_op->value = value;
+
+	batch->dest[batch->count] = dest;
+	batch->size[batch->count] = size;
+
+	batch->count++;
+
+	return 0;
+}
+
+/**
+ * idmf_batch_init - prepare an empty transaction
+ * @batch:	the transaction
+ * @board:	the board the transaction is executed on
+ */
+void idmf_batch_init(idmf_batch *batch, idmf_board *board) {
+	batch->board = board;
+	batch->count = 0;
+}
+
+/**
+ * idmf_batch_discard - drop all queued operations
+ * @batch:	the transaction
+ *
+ * Queued writes have not been recorded in the shadow yet, so nothing is
+ * left behind. The transaction is empty afterwards.
+ */
+void idmf_batch_discard(idmf_batch *batch) {
+	batch->count = 0;
+}
+
+/**
+ * idmf_batch_read - queue a register read
+ * @batch:	the transaction
+ * @address:	the register offset
+ * @value:	destination of the read value, may be NULL
+ *
+ * This function returns 0 or -ENOSPC when the transaction is full.
+ */
+int idmf_batch_read(idmf_batch *batch, __u32 address, __u32 *value) {
+	return batch_queue(batch, IDMF_OP_READ, address, 0, value,
+			sizeof(*value));
+}
+
+/**
+ * idmf_batch_write - queue a register write
+ * @batch:	the transaction
+ * @address:	the register offset
+ * @value:	the value to be written
+ *
+ * This function returns 0 or -ENOSPC when the transaction is full.
+ */
+int idmf_batch_write(idmf_batch *batch, __u32 address, __u32 value) {
+	return batch_queue(batch, IDMF_OP_WRITE, address, value, NULL, 0);
+}
+
+/**
+ * idmf_batch_flush - execute all queued operations
+ * @batch:	the transaction
+ *
+ * This function executes the queued operations in order within a single
+ * driver call and stores the values of the reads to their destinations.
+ * The transaction is empty afterwards.
+ *
+ * This function returns 0 or a negative error code.
+ */
+int idmf_batch_flush(idmf_batch *batch) {
+	struct idmf_xact xact;
+	unsigned int i;
+	int err;
+
+	if (!batch->count)
+		return 0;
+
+	xact.count = batch->count;
+	xact.reserved = 0;
+	xact.ops = (__u64) (unsigned long) batch->ops;
+
+	/* mapped registers are accessed directly */
+	if (batch->board->regs)
+		err = -ENOTTY;
+	else
+		err = board_ioctl(batch->board, IDMF_RTIOC_XACT, &xact);
+
+	if (err == -ENOTTY) {
+		err = 0;
+
+		for (i = 0; i < batch->count && !err; i++) {
+			if (batch->ops[i].op == IDMF_OP_READ)
+				batch->ops[i].value = reg_read_raw(batch->board,
+						batch->ops[i].offset);
+			else
+				err = reg_write_raw(batch->board, batch->ops[i].offset,
+						batch->ops[i].value);
+		}
+	}
+
+	for (i = 0; i < batch->count; i++) {
+		if (err) {
+			/* the board state is unknown after a failed transaction */
+			if (batch->ops[i].op == IDMF_OP_WRITE)
+				shadow_forget(batch->board, batch->ops[i].offset);
+			continue;
+		}
+
+		if (batch->ops[i].op == IDMF_OP_WRITE
+				|| (shadow_attr(batch->ops[i].offset) & SHADOW_RELOAD))
+			shadow_store(batch->board, batch->ops[i].offset,
+					batch->ops[i].value);
+
+		batch_store(batch->dest[i], batch->size[i], batch->ops[i].value);
+	}
+
+	batch->count = 0;
+
+	return err;
+}
+
+/**
+ * idmf_batch_dac_write - queue idmf_dac_write
+ * @batch:	the transaction
+ * @channel:	the channel of the DAC on the board
+ * @value:	the new value to be written
+ */
+int idmf_batch_dac_write(idmf_batch *batch, int channel, __s16 value) {
+	if ((channel < 0) || (channel >= NUM_DACS))
+		return -EINVAL;
+
+	return idmf_batch_write(batch, DAC_VALUE + channel * 0x04,
+			(__u32 ) value);
+}
+
+/**
+ * idmf_batch_dac_update - queue idmf_dac_update
+ * @batch:	the transaction
+ */
+int idmf_batch_dac_update(idmf_batch *batch) {
+	return idmf_batch_write(batch, DAC_CONF, 0x0000C000);
+}
+
+/**
+ * idmf_batch_adc_acquire - queue idmf_adc_acquire
+ * @batch:	the transaction
+ *
+ * The measurements are available through idmf_adc_read after the flush.
+ */
+int idmf_batch_adc_acquire(idmf_batch *batch) {
+	int i;
+	int err;
+
+	if (batch->count + NUM_ADCS > IDMF_XACT_MAX)
+		return -ENOSPC;
+
+	for (i = 0; i < NUM_ADCS; i++) {
+		err = batch_queue(batch, IDMF_OP_READ, ADC_DATA, 0,
+				&batch->board->adc_values[adc_fifo_order[i]],
+				sizeof(batch->board->adc_values[0]));
+		if (err)
+			return err;
+	}
+
+	return 0;
+}
+
+/**
+ * idmf_batch_port_read - queue a read of a whole data port
+ * @batch:	the transaction
+ * @port:	the port on the board
+ * @value:	destination of the port value
+ */
+int idmf_batch_port_read(idmf_batch *batch, int port, __u8 *value) {
+	if ((port < 0) || (port >= NUM_PORTS))
+		return -EINVAL;
+
+	return batch_queue(batch, IDMF_OP_READ, PRT_VALUE + port * 0x04, 0,
+			value, sizeof(*value));
+}
+
+/**
+ * idmf_batch_port_write - queue idmf_port_write
+ * @batch:	the transaction
+ * @port:	the port on the board
+ * @channel:	the channel within the port, or -1 for the whole port
+ * @value:	the new value to be written
+ */
+int idmf_batch_port_write(idmf_batch *batch, int port, int channel,
+		__u8 value) {
+	idmf_board *board = batch->board;
+
+	if ((port < 0) || (port >= NUM_PORTS))
+		return -EINVAL;
+
+	if ((channel < -1) || (channel >= NUM_PORT_CHANNELS))
+		return -EINVAL;
+	else if (channel == -1)
+		board->port_values[port] = value;
+	else
+		board->port_values[port] =
+				(board->port_values[port] & (~(1 << channel)))
+						| ((value ? 1 : 0) << channel);
+
+	return idmf_batch_write(batch, PRT_VALUE + port * 0x04,
+			board->port_values[port]);
+}
+
+/**
+ * idmf_batch_gpio_read - queue a read of all general-purpose I/O pins
+ * @batch:	the transaction
+ * @values:	destination of the pin values
+ */
+int idmf_batch_gpio_read(idmf_batch *batch, __u32 *values) {
+	return idmf_batch_read(batch, GPIO_IN, values);
+}
+
+/**
+ * idmf_batch_gpio_write - queue idmf_gpio_write
+ * @batch:	the transaction
+ * @channel:	the channel of the gpio on the board, or -1 for all pins
+ * @values:	the new values to be written
+ */
+int idmf_batch_gpio_write(idmf_batch *batch, int channel, __u32 values) {
+	idmf_board *board = batch->board;
+
+	if ((channel < -1) || (channel >= NUM_GPIOS))
+		return -EINVAL;
+	else if (channel == -1)
+		board->gpio_values = values;
+	else
+		board->gpio_values = (board->gpio_values & (~(1 << channel)))
+				| ((values ? 1 : 0) << channel);
+
+	return idmf_batch_write(batch, GPIO_OUT, board->gpio_values);
+}
+
+/**
+ * idmf_batch_enc_read - queue idmf_enc_read
+ * @batch:	the transaction
+ * @channel:	the channel of the encoder on the board
+ * @value:	destination of the count
+ */
+int idmf_batch_enc_read(idmf_batch *batch, int channel, __s32 *value) {
+	if ((channel < 0) || (channel >= NUM_ENCS))
+		return -EINVAL;
+
+	return batch_queue(batch, IDMF_OP_READ, MFC_CNT + channel * 0x40, 0,
+			value, sizeof(*value));
+}
+
+/**
+ * idmf_batch_enc_write - queue idmf_enc_write
+ * @batch:	the transaction
+ * @channel:	the channel of the encoder on the board
+ * @value:	the new count
+ */
+int idmf_batch_enc_write(idmf_batch *batch, int channel, __s32 value) {
+	if ((channel < 0) || (channel >= NUM_ENCS))
+		return -EINVAL;
+
+	return idmf_batch_write(batch, MFC_CNT + channel * 0x40, (__u32 ) value);
+}
+
+/**
+ * idmf_batch_led_write - queue idmf_led_write
+ * @batch:	the transaction
+ * @value:	the new LED state
+ */
+int idmf_batch_led_write(idmf_batch *batch, __u32 value) {
+	return idmf_batch_write(batch, BCT_LED, value ? 0x0001 : 0);
+}
@@ -29,81 +29,186 @@
 
 #include <linux/types.h>
 
-#define NUM_DACS		 8
-#define NUM_ADCS		 8
-#define NUM_PORTS		 3
-#define NUM_PORT_CHANNELS	 8
-#define NUM_ENCS		 8
-#define NUM_GPIOS		24
-
-#define DAC_CONF	0x0000
-#define DAC_VALUE	0x0020
-#define PRT_VALUE	0x0080
-#define PRT_CTRL	0x008C
-#define ENC_PWRCTRL	0x0090
-#define GPIO_DIR0	0x0094
-#define GPIO_DIR1	0x0098
-#define ENC_ALARM0	0x009C
-#define ENC_ALARM1	0x00A0
-#define ENC_PWRSTAT	0x00A4
-#define ADC_DATA	0x00A8
-#define ADC_REF		0x00AC
-#define BCT_LED		0x0200
-#define BCT_PWR		0x0204
-#define BCT_ADC		0x0208
-#define GPIO_IN		0x0210
-#define GPIO_OUT	0x0214
-#define MFC_CCR		0x0300
-#define MFC_CSR		0x0304
-#define MFC_CNT		0x0308
-#define MFC_PLV		0x030C
-#define MFC_DCR		0x0318
-
-#define REG_WRITE	0x10000000
-#define REG_READ	0x20000000
+#include "idmf_ioctl.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/* idmf_open_ex flags */
+#define IDMF_OPEN_MMAP		0x0001	/* access registers through a mapping */
+#define IDMF_OPEN_SIM		0x0002	/* use the in-process board simulator */
+#define IDMF_OPEN_NOCACHE	0x0004	/* do not shadow register values */
+
+struct idmf_transport;
+
 typedef struct {
 	char * DeviceName;
 
 	int handle;
+	int flags;
+
+	const struct idmf_transport * transport;
+	void * priv;
+
+	volatile __u32 * regs;
+	__u64 regs_size;
+
+	struct idmf_ring * ring;
+	__u64 ring_size;
 
 	__s16 adc_values[NUM_ADCS];
 	__u8 port_values[NUM_PORTS];
 	__u32 gpio_values;
+
+	__u32 shadow[IDMF_REG_WINDOW / 4];
+	__u32 shadow_valid[IDMF_REG_WINDOW / 128];
 } idmf_board;
 
+/**
+ * idmf_transport - access method of a board
+ * @name:	name of the transport
+ * @open:	opens board->DeviceName, returns 0 or a negative error code
+ * @close:	releases the board
+ * @reg_read:	reads a register
+ * @reg_write:	writes a register, returns 0 or a negative error code
+ * @ioctl:	executes a driver request, may be NULL
+ * @read:	reads from the driver, may be NULL
+ *
+ * A transport which does not implement a driver request returns -ENOTTY.
+ * The API then falls back to plain register accesses where possible.
+ */
+typedef struct idmf_transport {
+	const char * name;
+
+	int (*open)(idmf_board *board);
+	int (*close)(idmf_board *board);
+
+	__u32 (*reg_read)(idmf_board *board, __u32 address);
+	int (*reg_write)(idmf_board *board, __u32 address, __u32 value);
+
+	int (*ioctl)(idmf_board *board, unsigned int request, void *arg);
+	int (*read)(idmf_board *board, void *buf, __u32 size);
+} idmf_transport;
+
+/**
+ * idmf_batch - register transaction builder
+ *
+ * Register operations are queued with the idmf_batch_* functions and executed
+ * by idmf_batch_flush in a single driver call. Values of queued reads are
+ * stored to their destinations during the flush.
+ */
+typedef struct {
+	idmf_board *board;
+
+	unsigned int count;
+
+	struct idmf_reg_op ops[IDMF_XACT_MAX];
+	void * dest[IDMF_XACT_MAX];
+	__u8 size[IDMF_XACT_MAX];
+} idmf_batch;
+
 idmf_board * idmf_open(const char * nDeviceName);
+idmf_board * idmf_open_ex(const char * nDeviceName, int flags);
 int idmf_close(idmf_board *board);
 
-static inline void reg_write(idmf_board *board, __u32 address, __u32 value);
+int idmf_claim(idmf_board *board, struct idmf_claim *claim);
+int idmf_release(idmf_board *board, struct idmf_claim *claim);
+
+int idmf_prog_load(idmf_board *board, const struct idmf_prog_op *ops,
+		int count);
+int idmf_prog_unload(idmf_board *board, int handle);
+int idmf_prog_run(idmf_board *board, struct idmf_prog_run *run);
+
+__u32 idmf_reg_read(idmf_board *board, __u32 address);
+int idmf_reg_write(idmf_board *board, __u32 address, __u32 value);
+
+void idmf_shadow_invalidate(idmf_board *board);
+int idmf_shadow_resync(idmf_board *board);
+
+static inline int reg_write(idmf_board *board, __u32 address, __u32 value);
 
 static inline __u32 reg_read(idmf_board *board, __u32 address);
 
 __s16 idmf_dac_read(idmf_board *board, int channel);
-void idmf_dac_write(idmf_board *board, int channel, __s16 value);
+int idmf_dac_write(idmf_board *board, int channel, __s16 value);
 void idmf_dac_update(idmf_board *board);
 
-void idmf_adc_config(idmf_board *board, __u16 refadc, __u16 refina);
-void idmf_adc_update(idmf_board *board);
+int idmf_adc_config(idmf_board *board, __u16 refadc, __u16 refina);
+void idmf_adc_request(idmf_board *board);
+void idmf_adc_run(idmf_board *board);
+void idmf_adc_acquire(idmf_board *board);
+int idmf_adc_update(idmf_board *board);
+int idmf_adc_submit(idmf_board *board, __u32 *seq);
+int idmf_adc_complete(idmf_board *board, __s64 timeout,
+		struct idmf_adc_frame *frame, __u32 *seq);
 __s16 idmf_adc_read(idmf_board *board, int channel);
 
 void idmf_port_config(idmf_board *board, int dirx, int diry, int dirz);
 __u8 idmf_port_read(idmf_board *board, int port, int channel);
-void idmf_port_write(idmf_board *board, int port, int channel, __u8 value);
+int idmf_port_write(idmf_board *board, int port, int channel, __u8 value);
+int idmf_port_bits(idmf_board *board, int port, __u8 set, __u8 clear,
+		__u8 toggle);
 
 void idmf_gpio_config(idmf_board *board, __u32 dirs);
 __u32 idmf_gpio_read(idmf_board *board, int channel);
-void idmf_gpio_write(idmf_board *board, int channel, __u32 value);
+int idmf_gpio_write(idmf_board *board, int channel, __u32 value);
+int idmf_gpio_bits(idmf_board *board, __u32 set, __u32 clear, __u32 toggle);
 
 void idmf_enc_config(idmf_board *board, int channel, int mode);
 __s32 idmf_enc_read(idmf_board *board, int channel);
 void idmf_enc_write(idmf_board *board, int channel, __s32 value);
+int idmf_enc_track_config(idmf_board *board, __u64 window_ns);
+int idmf_enc_track_read(idmf_board *board, struct idmf_enc_track *track);
 
 void idmf_led_write(idmf_board *board, __u32 value);
+void idmf_led_read(idmf_board *board, __u32 * value);
+
+int idmf_snapshot(idmf_board *board, struct idmf_snapshot *snap);
+int idmf_group_snapshot(idmf_board *board, struct idmf_group_frame *frame);
+int idmf_output_commit(idmf_board *board, const struct idmf_out_frame *frame);
+
+int idmf_acq_start(idmf_board *board, const struct idmf_acq_config *config);
+int idmf_acq_stop(idmf_board *board);
+int idmf_acq_status(idmf_board *board, struct idmf_acq_status *status);
+int idmf_acq_read(idmf_board *board, struct idmf_sample *samples, int count);
+int idmf_adc_accum(idmf_board *board, __u32 flags,
+		struct idmf_adc_accum *accum);
+
+int idmf_mon_start(idmf_board *board, const struct idmf_mon_config *config);
+int idmf_mon_stop(idmf_board *board);
+int idmf_mon_read(idmf_board *board, struct idmf_mon_event *events, int count,
+		__s64 timeout, __u32 *lost);
+
+int idmf_ring_map(idmf_board *board);
+int idmf_ring_peek(idmf_board *board, struct idmf_sample **samples);
+void idmf_ring_commit(idmf_board *board, int count);
+int idmf_ring_wait(idmf_board *board, int count);
+
+int idmf_irq_wait(idmf_board *board, __s64 timeout, __u32 flags,
+		struct idmf_irq_event *event);
+
+int idmf_trace_enable(idmf_board *board, int enable, __u32 *head);
+int idmf_trace_read(idmf_board *board, struct idmf_trace_entry *entries,
+		int count, __u32 *seq, __u32 *lost);
+
+void idmf_batch_init(idmf_batch *batch, idmf_board *board);
+int idmf_batch_read(idmf_batch *batch, __u32 address, __u32 *value);
+int idmf_batch_write(idmf_batch *batch, __u32 address, __u32 value);
+int idmf_batch_flush(idmf_batch *batch);
+void idmf_batch_discard(idmf_batch *batch);
+
+int idmf_batch_dac_write(idmf_batch *batch, int channel, __s16 value);
+int idmf_batch_dac_update(idmf_batch *batch);
+int idmf_batch_adc_acquire(idmf_batch *batch);
+int idmf_batch_port_read(idmf_batch *batch, int port, __u8 *value);
+int idmf_batch_port_write(idmf_batch *batch, int port, int channel,
+		__u8 value);
+int idmf_batch_gpio_read(idmf_batch *batch, __u32 *values);
+int idmf_batch_gpio_write(idmf_batch *batch, int channel, __u32 values);
+int idmf_batch_enc_read(idmf_batch *batch, int channel, __s32 *value);
+int idmf_batch_enc_write(idmf_batch *batch, int channel, __s32 value);
+int idmf_batch_led_write(idmf_batch *batch, __u32 value);
 
 #ifdef __cplusplus
 }
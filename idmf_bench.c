@@ -0,0 +1,199 @@
+/***************************************************************************
+ *   Copyright (C) 2015 by Wojciech Domski                                 *
+ *   Wojciech.Domski@gmail.com                                             *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+/*
+ * Measures the cost of typical control cycles issued through the API.
+ *
+ * usage: idmf_bench [device] [cycles]
+ *
+ * Built against the simulator (make sim) the latency charged per call and
+ * per register access is taken from IDMF_SIM_CALL_NS and IDMF_SIM_ACCESS_NS.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "idmf_api.h"
+#include "idmf_sim.h"
+
+char device[64] = "idmf0";
+
+static unsigned long long now_ns(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (unsigned long long) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* one cycle with a call per register */
+static void cycle_single(idmf_board *board) {
+	__s32 enc[NUM_ENCS];
+	__u8 port[NUM_PORTS];
+	__u32 gpio;
+	int i;
+
+	idmf_adc_update(board);
+
+	for (i = 0; i < NUM_ENCS; i++)
+		enc[i] = idmf_enc_read(board, i);
+
+	for (i = 0; i < NUM_PORTS; i++)
+		port[i] = idmf_port_read(board, i, -1);
+
+	gpio = idmf_gpio_read(board, -1);
+
+	for (i = 0; i < NUM_DACS; i++)
+		idmf_dac_write(board, i, (__s16) (enc[i] + port[i % NUM_PORTS] + gpio));
+
+	idmf_dac_update(board);
+}
+
+/* the same cycle with the register accesses batched */
+static void cycle_batch(idmf_board *board) {
+	idmf_batch batch;
+	__s32 enc[NUM_ENCS];
+	__u8 port[NUM_PORTS];
+	__u32 gpio;
+	int i;
+
+	idmf_adc_update(board);
+
+	idmf_batch_init(&batch, board);
+
+	for (i = 0; i < NUM_ENCS; i++)
+		idmf_batch_enc_read(&batch, i, &enc[i]);
+
+	for (i = 0; i < NUM_PORTS; i++)
+		idmf_batch_port_read(&batch, i, &port[i]);
+
+	idmf_batch_gpio_read(&batch, &gpio);
+
+	idmf_batch_flush(&batch);
+
+	for (i = 0; i < NUM_DACS; i++)
+		idmf_batch_dac_write(&batch, i,
+				(__s16) (enc[i] + port[i % NUM_PORTS] + gpio));
+
+	idmf_batch_dac_update(&batch);
+
+	idmf_batch_flush(&batch);
+}
+
+/* the same cycle with the inputs taken by one snapshot */
+static void cycle_snapshot(idmf_board *board) {
+	struct idmf_snapshot snap;
+	idmf_batch batch;
+	int i;
+
+	idmf_snapshot(board, &snap);
+
+	idmf_batch_init(&batch, board);
+
+	for (i = 0; i < NUM_DACS; i++)
+		idmf_batch_dac_write(&batch, i,
+				(__s16) (snap.enc[i] + snap.port[i % NUM_PORTS] + snap.gpio));
+
+	idmf_batch_dac_update(&batch);
+
+	idmf_batch_flush(&batch);
+}
+
+/* the snapshot cycle with the outputs written by one commit */
+static void cycle_frame(idmf_board *board) {
+	struct idmf_snapshot snap;
+	struct idmf_out_frame frame;
+	int i;
+
+	idmf_snapshot(board, &snap);
+
+	memset(&frame, 0, sizeof(frame));
+	frame.dac_mask = (1 << NUM_DACS) - 1;
+
+	for (i = 0; i < NUM_DACS; i++)
+		frame.dac[i] = (__s16) (snap.enc[i] + snap.port[i % NUM_PORTS]
+				+ snap.gpio);
+
+	idmf_output_commit(board, &frame);
+}
+
+static void run(const char *name, idmf_board *board,
+		void (*cycle)(idmf_board *), int cycles) {
+	unsigned long long start, stop;
+	__u64 calls = 0, accesses = 0;
+	int i;
+
+	idmf_sim_get_stats(board, &calls, &accesses);
+
+	start = now_ns();
+
+	for (i = 0; i < cycles; i++)
+		cycle(board);
+
+	stop = now_ns();
+
+	printf("%-8s %10.1f ns/cycle", name, (double) (stop - start) / cycles);
+
+	if (board->transport == &idmf_sim_transport) {
+		__u64 calls_end, accesses_end;
+
+		idmf_sim_get_stats(board, &calls_end, &accesses_end);
+
+		printf("  %6.1f calls/cycle  %6.1f accesses/cycle",
+				(double) (calls_end - calls) / cycles,
+				(double) (accesses_end - accesses) / cycles);
+	}
+
+	printf("\n");
+}
+
+int main(int argc, char * argv[]) {
+	idmf_board * idmf;
+	int cycles = 10000;
+
+	if (argc >= 2)
+		strcpy(device, argv[1]);
+
+	if (argc >= 3)
+		cycles = atoi(argv[2]);
+
+	if (cycles <= 0)
+		cycles = 1;
+
+	idmf = idmf_open(device);
+
+	if (!idmf) {
+		printf("Error while opening device\n");
+
+		return -1;
+	}
+
+	printf("%s (%s), %d cycles\n", device, idmf->transport->name, cycles);
+
+	run("single", idmf, cycle_single, cycles);
+	run("batch", idmf, cycle_batch, cycles);
+	run("snapshot", idmf, cycle_snapshot, cycles);
+	run("frame", idmf, cycle_frame, cycles);
+
+	idmf_close(idmf);
+
+	return 0;
+}
@@ -0,0 +1,353 @@
+/*
+ * Author Wojciech Domski 2015
+ * www.domski.pl
+ *
+ * Calibration of the ADC samples and their conversion to volts.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <string.h>
+#include <errno.h>
+
+#include "idmf_calib.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CALIB_X86
+#include <immintrin.h>
+#endif
+
+/* the vector kernels hold a whole frame in one AVX or two SSE registers */
+#if NUM_ADCS != 8
+#error "idmf_calib expects 8 ADC channels"
+#endif
+
+#define CALIB_LUT_STEP		(1 << IDMF_CALIB_LUT_SHIFT)
+#define CALIB_LUT_MASK		(CALIB_LUT_STEP - 1)
+
+/*
+ * coefficients of the polynomial regrouped by order, poly[k] holds the
+ * coefficients of v^k of all channels
+ */
+struct calib_poly {
+	float poly[IDMF_CALIB_POLY_MAX][NUM_ADCS];
+};
+
+static void calib_poly_lanes(const idmf_calib *calib, struct calib_poly *lanes) {
+	int ch;
+	int k;
+
+	for (k = 0; k < IDMF_CALIB_POLY_MAX; k++)
+		for (ch = 0; ch < NUM_ADCS; ch++)
+			lanes->poly[k][ch] = calib->poly[ch][k];
+}
+
+static void calib_lut_linear(idmf_calib *calib, int channel) {
+	int n;
+
+	for (n = 0; n < IDMF_CALIB_LUT_POINTS; n++)
+		calib->lut[channel][n] = (float) (n * CALIB_LUT_STEP - 32768)
+				* calib->gain[channel] + calib->offset[channel];
+}
+
+/*****************************************************************************/
+/* Conversion kernels */
+
+static void calib_block_scalar(const idmf_calib *calib, const __s16 *raw,
+		float *volts, size_t frames) {
+	const float *lut;
+	unsigned int code;
+	float frac;
+	float v;
+	size_t i;
+	int ch;
+	int k;
+
+	for (i = 0; i < frames; i++, raw += NUM_ADCS, volts += NUM_ADCS) {
+		for (ch = 0; ch < NUM_ADCS; ch++) {
+			if (calib->mode == IDMF_CALIB_LUT) {
+				lut = calib->lut[ch];
+				code = (unsigned int) (raw[ch] + 32768);
+				frac = (float) (code & CALIB_LUT_MASK)
+						* (1.0f / CALIB_LUT_STEP);
+				lut += code >> IDMF_CALIB_LUT_SHIFT;
+
+				volts[ch] = lut[0] + (lut[1] - lut[0]) * frac;
+				continue;
+			}
+
+			v = (float) raw[ch] * calib->gain[ch] + calib->offset[ch];
+
+			if (calib->mode == IDMF_CALIB_POLY) {
+				k = IDMF_CALIB_POLY_MAX - 1;
+				volts[ch] = calib->poly[ch][k];
+				while (k--)
+					volts[ch] = volts[ch] * v + calib->poly[ch][k];
+			} else
+				volts[ch] = v;
+		}
+	}
+}
+
+#ifdef CALIB_X86
+
+__attribute__((target("sse2")))
+static void calib_block_sse2(const idmf_calib *calib, const __s16 *raw,
+		float *volts, size_t frames) {
+	__m128 gain_lo = _mm_loadu_ps(calib->gain);
+	__m128 gain_hi = _mm_loadu_ps(calib->gain + 4);
+	__m128 offset_lo = _mm_loadu_ps(calib->offset);
+	__m128 offset_hi = _mm_loadu_ps(calib->offset + 4);
+	__m128 poly_lo[IDMF_CALIB_POLY_MAX];
+	__m128 poly_hi[IDMF_CALIB_POLY_MAX];
+	struct calib_poly lanes;
+	__m128i s;
+	__m128 lo;
+	__m128 hi;
+	__m128 r_lo;
+	__m128 r_hi;
+	size_t i;
+	int k;
+
+	calib_poly_lanes(calib, &lanes);
+	for (k = 0; k < IDMF_CALIB_POLY_MAX; k++) {
+		poly_lo[k] = _mm_loadu_ps(lanes.poly[k]);
+		poly_hi[k] = _mm_loadu_ps(lanes.poly[k] + 4);
+	}
+
+	for (i = 0; i < frames; i++, raw += NUM_ADCS, volts += NUM_ADCS) {
+		s = _mm_loadu_si128((const __m128i *) raw);
+
+		/* sign extension of the samples to 32 bits */
+		lo = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(s, s), 16));
+		hi = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(s, s), 16));
+
+		lo = _mm_add_ps(_mm_mul_ps(lo, gain_lo), offset_lo);
+		hi = _mm_add_ps(_mm_mul_ps(hi, gain_hi), offset_hi);
+
+		if (calib->mode == IDMF_CALIB_POLY) {
+			k = IDMF_CALIB_POLY_MAX - 1;
+			r_lo = poly_lo[k];
+			r_hi = poly_hi[k];
+			while (k--) {
+				r_lo = _mm_add_ps(_mm_mul_ps(r_lo, lo), poly_lo[k]);
+				r_hi = _mm_add_ps(_mm_mul_ps(r_hi, hi), poly_hi[k]);
+			}
+			lo = r_lo;
+			hi = r_hi;
+		}
+
+		_mm_storeu_ps(volts, lo);
+		_mm_storeu_ps(volts + 4, hi);
+	}
+}
+
+__attribute__((target("avx2")))
+static void calib_block_avx2(const idmf_calib *calib, const __s16 *raw,
+		float *volts, size_t frames) {
+	__m256 gain = _mm256_loadu_ps(calib->gain);
+	__m256 offset = _mm256_loadu_ps(calib->offset);
+	__m256 poly[IDMF_CALIB_POLY_MAX];
+	struct calib_poly lanes;
+	__m256 v;
+	__m256 r;
+	size_t i;
+	int k;
+
+	calib_poly_lanes(calib, &lanes);
+	for (k = 0; k < IDMF_CALIB_POLY_MAX; k++)
+		poly[k] = _mm256_loadu_ps(lanes.poly[k]);
+
+	for (i = 0; i < frames; i++, raw += NUM_ADCS, volts += NUM_ADCS) {
+		v = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(
+				_mm_loadu_si128((const __m128i *) raw)));
+
+		v = _mm256_add_ps(_mm256_mul_ps(v, gain), offset);
+
+		if (calib->mode == IDMF_CALIB_POLY) {
+			k = IDMF_CALIB_POLY_MAX - 1;
+			r = poly[k];
+			while (k--)
+				r = _mm256_add_ps(_mm256_mul_ps(r, v), poly[k]);
+			v = r;
+		}
+
+		_mm256_storeu_ps(volts, v);
+	}
+}
+
+#endif
+
+/*****************************************************************************/
+/* Calibration functions */
+
+/**
+ * idmf_calib_lsb - get the weight of an ADC code
+ * @refadc:	reference voltage of ADC given to idmf_adc_config
+ *
+ * The ADC codes are signed, the full scale of +/- refadc corresponds to
+ * +/- 32768 codes. The reference of the INA shifts the level of the input
+ * amplifier and does not enter the scale.
+ *
+ * This function returns volts per LSB.
+ */
+float idmf_calib_lsb(__u16 refadc) {
+	return (float) (refadc * 5.0 / 65536.0 / 32768.0);
+}
+
+/**
+ * idmf_calib_init - initialize a calibration
+ * @calib:	the calibration
+ * @lsb:	volts per LSB of all channels, see idmf_calib_lsb
+ *
+ * All channels get the gain @lsb and no offset. The conversion kernel is
+ * chosen for the CPU the function is running on.
+ */
+void idmf_calib_init(idmf_calib *calib, float lsb) {
+	int ch;
+
+	memset(calib, 0, sizeof(*calib));
+
+	calib->mode = IDMF_CALIB_LINEAR;
+	calib->isa = IDMF_CALIB_ISA_SCALAR;
+
+#ifdef CALIB_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		calib->isa = IDMF_CALIB_ISA_AVX2;
+	else if (__builtin_cpu_supports("sse2"))
+		calib->isa = IDMF_CALIB_ISA_SSE2;
+#endif
+
+	for (ch = 0; ch < NUM_ADCS; ch++) {
+		calib->gain[ch] = lsb;
+		calib->poly[ch][1] = 1.0f;
+		calib_lut_linear(calib, ch);
+	}
+}
+
+/**
+ * idmf_calib_set_linear - set the gain and offset of a channel
+ * @calib:	the calibration
+ * @channel:	ADC channel
+ * @gain:	volts per LSB
+ * @offset:	volts added after the gain
+ *
+ * The table of the channel is reset to the same straight line.
+ *
+ * This function returns 0 or -EINVAL.
+ */
+int idmf_calib_set_linear(idmf_calib *calib, int channel, float gain,
+		float offset) {
+	if ((channel < 0) || (channel >= NUM_ADCS))
+		return -EINVAL;
+
+	calib->gain[channel] = gain;
+	calib->offset[channel] = offset;
+	calib_lut_linear(calib, channel);
+
+	return 0;
+}
+
+/**
+ * idmf_calib_set_poly - linearize a channel by a polynomial
+ * @calib:	the calibration
+ * @channel:	ADC channel
+ * @coeffs:	coefficients starting with the constant term
+ * @count:	number of coefficients, up to IDMF_CALIB_POLY_MAX
+ *
+ * The polynomial is applied to the value given by the gain and offset and
+ * the calibration is switched to IDMF_CALIB_POLY.
+ *
+ * This function returns 0 or -EINVAL.
+ */
+int idmf_calib_set_poly(idmf_calib *calib, int channel, const float *coeffs,
+		int count) {
+	int k;
+
+	if ((channel < 0) || (channel >= NUM_ADCS))
+		return -EINVAL;
+
+	if ((count <= 0) || (count > IDMF_CALIB_POLY_MAX))
+		return -EINVAL;
+
+	for (k = 0; k < IDMF_CALIB_POLY_MAX; k++)
+		calib->poly[channel][k] = k < count ? coeffs[k] : 0.0f;
+
+	calib->mode = IDMF_CALIB_POLY;
+
+	return 0;
+}
+
+/**
+ * idmf_calib_set_lut - linearize a channel by a table
+ * @calib:	the calibration
+ * @channel:	ADC channel
+ * @volts:	IDMF_CALIB_LUT_POINTS volts, see idmf_calib
+ *
+ * The calibration is switched to IDMF_CALIB_LUT. Tables are converted by the
+ * scalar kernel.
+ *
+ * This function returns 0 or -EINVAL.
+ */
+int idmf_calib_set_lut(idmf_calib *calib, int channel, const float *volts) {
+	if ((channel < 0) || (channel >= NUM_ADCS))
+		return -EINVAL;
+
+	memcpy(calib->lut[channel], volts, sizeof(calib->lut[channel]));
+
+	calib->mode = IDMF_CALIB_LUT;
+
+	return 0;
+}
+
+/**
+ * idmf_calib_block - convert ADC frames to volts
+ * @calib:	the calibration
+ * @raw:	@frames frames of NUM_ADCS samples each
+ * @volts:	@frames frames of NUM_ADCS volts each
+ * @frames:	number of frames
+ *
+ * The frames are stored one after another, as in adc_values or the adc
+ * member of idmf_snapshot.
+ */
+void idmf_calib_block(const idmf_calib *calib, const __s16 *raw, float *volts,
+		size_t frames) {
+#ifdef CALIB_X86
+	if (calib->mode != IDMF_CALIB_LUT) {
+		if (calib->isa == IDMF_CALIB_ISA_AVX2) {
+			calib_block_avx2(calib, raw, volts, frames);
+			return;
+		}
+
+		if (calib->isa == IDMF_CALIB_ISA_SSE2) {
+			calib_block_sse2(calib, raw, volts, frames);
+			return;
+		}
+	}
+#endif
+
+	calib_block_scalar(calib, raw, volts, frames);
+}
+
+/**
+ * idmf_calib_frame - convert one ADC frame to volts
+ * @calib:	the calibration
+ * @raw:	NUM_ADCS samples
+ * @volts:	NUM_ADCS volts
+ */
+void idmf_calib_frame(const idmf_calib *calib, const __s16 *raw, float *volts) {
+	idmf_calib_block(calib, raw, volts, 1);
+}
@@ -0,0 +1,92 @@
+/*
+ * Author Wojciech Domski 2015
+ * www.domski.pl
+ *
+ * Calibration of the ADC samples and their conversion to volts.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef __IDMF_CALIB_H
+#define __IDMF_CALIB_H
+
+#include <stddef.h>
+
+#include "idmf_api.h"
+
+/* linearization of idmf_calib */
+#define IDMF_CALIB_LINEAR	0	/* gain and offset */
+#define IDMF_CALIB_POLY		1	/* polynomial of the linear value */
+#define IDMF_CALIB_LUT		2	/* table of the raw codes */
+
+/* number of polynomial coefficients, up to the third order */
+#define IDMF_CALIB_POLY_MAX	4
+
+/* the table holds a point every 2^IDMF_CALIB_LUT_SHIFT raw codes */
+#define IDMF_CALIB_LUT_SHIFT	8
+#define IDMF_CALIB_LUT_POINTS	((65536 >> IDMF_CALIB_LUT_SHIFT) + 1)
+
+/* conversion kernels */
+#define IDMF_CALIB_ISA_SCALAR	0
+#define IDMF_CALIB_ISA_SSE2	1
+#define IDMF_CALIB_ISA_AVX2	2
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * idmf_calib - calibration of the ADC channels
+ * @mode:	IDMF_CALIB_* linearization
+ * @isa:	IDMF_CALIB_ISA_* kernel, set to the best one by idmf_calib_init
+ * @gain:	volts per LSB
+ * @offset:	volts added after the gain
+ * @poly:	coefficients applied to the linear value v as
+ *		poly[0] + poly[1] v + poly[2] v^2 + poly[3] v^3
+ * @lut:	volts at the raw codes -32768 + n * 2^IDMF_CALIB_LUT_SHIFT,
+ *		interpolated linearly; gain and offset are not applied
+ *
+ * The linearization is common to all channels, a channel without its own
+ * polynomial or table keeps the gain and offset only.
+ */
+typedef struct {
+	int mode;
+	int isa;
+
+	float gain[NUM_ADCS];
+	float offset[NUM_ADCS];
+
+	float poly[NUM_ADCS][IDMF_CALIB_POLY_MAX];
+	float lut[NUM_ADCS][IDMF_CALIB_LUT_POINTS];
+} idmf_calib;
+
+float idmf_calib_lsb(__u16 refadc);
+void idmf_calib_init(idmf_calib *calib, float lsb);
+
+int idmf_calib_set_linear(idmf_calib *calib, int channel, float gain,
+		float offset);
+int idmf_calib_set_poly(idmf_calib *calib, int channel, const float *coeffs,
+		int count);
+int idmf_calib_set_lut(idmf_calib *calib, int channel, const float *volts);
+
+void idmf_calib_frame(const idmf_calib *calib, const __s16 *raw, float *volts);
+void idmf_calib_block(const idmf_calib *calib, const __s16 *raw, float *volts,
+		size_t frames);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
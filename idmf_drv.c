@@ -29,6 +29,14 @@
 #include <linux/interrupt.h>
 #include <linux/pci.h>
 #include <linux/fs.h>
+#include <linux/mm.h>
+#include <linux/delay.h>
+#include <linux/vmalloc.h>
+#include <linux/math64.h>
+#include <linux/time.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file.h>
+#include <linux/version.h>
 #include <rtdm/rtdm_driver.h>
 
 #include "idmf_drv.h"
@@ -40,48 +48,3195 @@ MODULE_LICENSE ("GPL v2");
 
 static LIST_HEAD( idmf_list);
 
+/* protects idmf_list against the walk of idmf_group_snapshot */
+static rtdm_lock_t idmf_list_lock;
+
+static int use_irq = 0;
+module_param(use_irq, int, 0444);
+MODULE_PARM_DESC(use_irq, "request the board interrupt (default 0)");
+
+/*
+ * The event flags of a counter occupy the low byte of its MFC_CSR, the upper
+ * bits hold its configuration. By default every flag counts as an interrupt
+ * source, so no enabled event can leave the line asserted unacknowledged.
+ */
+static uint irq_csr_mask = 0xFF;
+module_param(irq_csr_mask, uint, 0444);
+MODULE_PARM_DESC(irq_csr_mask,
+		"MFC_CSR bits reporting a counter event (default 0xFF)");
+
 /* module global variables */
 static const char driver_name[] = "idmf-rtdm";
 
-/* init flags */
-#define INIT_PCI_ENABLE				0x0001
-#define INIT_PCI_REQUEST_REGIONS	0x0002
-#define INIT_PCI_IOMAP				0x0004
-#define INIT_PCI_REQUEST_IRQ		0x0008
-#define INIT_IDMF_MINOR_RESERVE		0x0010
-#define INIT_CDEV_ADD				0x0020
-#define INIT_DEVICE_CREATE			0x0040
-#define INIT_CREATE_ATTRIBUTES		0x0080
+/* init flags */
+#define INIT_PCI_ENABLE				0x0001
+#define INIT_PCI_REQUEST_REGIONS	0x0002
+#define INIT_PCI_IOMAP				0x0004
+#define INIT_PCI_REQUEST_IRQ		0x0008
+#define INIT_IDMF_MINOR_RESERVE		0x0010
+#define INIT_CDEV_ADD				0x0020
+#define INIT_DEVICE_CREATE			0x0040
+#define INIT_CREATE_ATTRIBUTES		0x0080
+#define INIT_ACQ			0x0100
+#define INIT_MON			0x0200
+#define INIT_ADC			0x0400
+
+int idmf_open(struct rtdm_dev_context *context, rtdm_user_info_t * user_info,
+		int oflags);
+
+int idmf_close(struct rtdm_dev_context *context, rtdm_user_info_t * user_info);
+
+int idmf_ioctl(struct rtdm_dev_context *context, rtdm_user_info_t *user_info,
+		unsigned int request, void __user *arg);
+
+ssize_t idmf_read(struct rtdm_dev_context *context,
+		rtdm_user_info_t *user_info, void *buf, size_t nbyte);
+
+static void idmf_pci_remove(struct pci_dev *pdev);
+
+static int idmf_pci_probe(struct pci_dev *pdev, const struct pci_device_id *id);
+
+/* number of transaction operations copied from user space at once */
+#define IDMF_XACT_CHUNK		16
+
+/* ADC request and conversion time in nanoseconds */
+#define IDMF_ADC_REQUEST_NS	1000
+#define IDMF_ADC_CONVERT_NS	3000
+
+/*
+ * a synchronous conversion waits for a running one, polling every
+ * IDMF_ADC_POLL_NS; the running conversion takes IDMF_ADC_REQUEST_NS
+ * + IDMF_ADC_CONVERT_NS plus the timer latency, IDMF_ADC_IDLE_NS only
+ * bounds the wait should the timer never fire or its owner be preempted
+ */
+#define IDMF_ADC_POLL_NS	500
+#define IDMF_ADC_IDLE_NS	1000000
+
+/* order in which the board delivers the ADC channels through ADC_DATA */
+static const int idmf_adc_order[NUM_ADCS] = { 5, 4, 1, 0, 3, 2, 7, 6 };
+
+/* seq of a trace entry being written, never used as a sequence number */
+#define IDMF_TRACE_BUSY		0xFFFFFFFF
+
+static void idmf_trace_record(struct idmf_board *board, u16 op, u32 offset,
+		u32 value, nanosecs_abs_t start)
+{
+	struct idmf_trace *trace = &board->trace;
+	struct idmf_trace_entry *entry;
+	nanosecs_abs_t stop = rtdm_clock_read();
+	u32 seq;
+
+	do {
+		seq = (u32)atomic_inc_return(&trace->head) - 1;
+	} while (unlikely(seq == IDMF_TRACE_BUSY));
+
+	entry = &trace->ring[seq & (IDMF_TRACE_FRAMES - 1)];
+
+	entry->seq = IDMF_TRACE_BUSY;
+	smp_wmb();
+
+	entry->timestamp = start;
+	entry->op = op;
+	entry->offset = (u16)offset;
+	entry->value = value;
+	entry->duration = (u32)(stop - start);
+
+	smp_wmb();
+	entry->seq = seq;
+}
+
+static noinline u32 idmf_reg_read_traced(struct idmf_board *board, u32 offset)
+{
+	nanosecs_abs_t start = rtdm_clock_read();
+	u32 value = ioread32((u8 *)board->base + offset);
+
+	idmf_trace_record(board, IDMF_OP_READ, offset, value, start);
+
+	return value;
+}
+
+static noinline void idmf_reg_write_traced(struct idmf_board *board,
+		u32 offset, u32 value)
+{
+	nanosecs_abs_t start = rtdm_clock_read();
+
+	iowrite32(value, (u8 *)board->base + offset);
+
+	idmf_trace_record(board, IDMF_OP_WRITE, offset, value, start);
+}
+
+static inline u32 idmf_reg_read(struct idmf_board *board, u32 offset)
+{
+	if (likely(offset < IDMF_REG_WINDOW))
+		board->stats.reads[offset >> 2]++;
+
+	if (unlikely(board->trace.enabled))
+		return idmf_reg_read_traced(board, offset);
+
+	return ioread32((u8 *)board->base + offset);
+}
+
+static inline void idmf_reg_write(struct idmf_board *board, u32 offset,
+		u32 value)
+{
+	if (likely(offset < IDMF_REG_WINDOW))
+		board->stats.writes[offset >> 2]++;
+
+	if (unlikely(board->trace.enabled)) {
+		idmf_reg_write_traced(board, offset, value);
+		return;
+	}
+
+	iowrite32(value, (u8 *)board->base + offset);
+}
+
+/**
+ * idmf_stats_record - record a duration in a latency histogram
+ * @board:	the board
+ * @index:	IDMF_STAT_* histogram
+ * @ns:		the duration
+ */
+static inline void idmf_stats_record(struct idmf_board *board, int index,
+		u64 ns)
+{
+	struct idmf_stat_hist *hist = &board->stats.hist[index];
+	int bucket = (ns >> 32) ? IDMF_STAT_BUCKETS : fls((u32)ns);
+
+	if (bucket >= IDMF_STAT_BUCKETS)
+		bucket = IDMF_STAT_BUCKETS - 1;
+
+	hist->count++;
+	hist->total += ns;
+	if (ns > hist->max)
+		hist->max = ns;
+	hist->bucket[bucket]++;
+}
+
+static inline int idmf_reg_valid(u32 offset)
+{
+	return !(offset & 0x03) && offset < IDMF_REG_WINDOW;
+}
+
+/* DAC_CONF value latching all DAC_VALUE registers */
+#define IDMF_DAC_LATCH		0x0000C000
+
+/* bits of idmf_out.valid */
+#define IDMF_OUT_VALID_DAC(ch)	(1 << (ch))
+#define IDMF_OUT_VALID_PORT(p)	(1 << (NUM_DACS + (p)))
+#define IDMF_OUT_VALID_GPIO	(1 << (NUM_DACS + NUM_PORTS))
+#define IDMF_OUT_VALID_LED	(1 << (NUM_DACS + NUM_PORTS + 1))
+
+/* restarts the tracking of an encoder at its next reading */
+static void idmf_enc_restart(struct idmf_board *board, int channel)
+{
+	rtdm_lockctx_t lock_ctx;
+
+	rtdm_lock_get_irqsave(&board->enc.lock, lock_ctx);
+	board->enc.chan[channel].valid = 0;
+	board->enc.chan[channel].head = 0;
+	rtdm_lock_put_irqrestore(&board->enc.lock, lock_ctx);
+}
+
+/*
+ * Returns the velocity of an encoder over the window ending at the last
+ * reading. The history holds a reading every window / IDMF_ENC_HISTORY, so
+ * it spans the whole window at any reading rate. Called with enc->lock held.
+ */
+static s32 idmf_enc_velocity(struct idmf_enc *enc, struct idmf_enc_chan *chan)
+{
+	u32 count = min_t(u32, chan->head, IDMF_ENC_HISTORY);
+	s64 delta = 0;
+	u64 dt = 0;
+	u32 slot;
+	u32 n;
+
+	for (n = 0; n < count; n++) {
+		slot = (chan->head - 1 - n) & (IDMF_ENC_HISTORY - 1);
+		if (chan->time[slot] == chan->timestamp)
+			continue;
+
+		dt = chan->timestamp - chan->time[slot];
+		delta = chan->position - chan->pos[slot];
+		if (dt >= enc->window)
+			break;
+	}
+
+	if (!dt)
+		return 0;
+
+	/* the product stays below 2^63 */
+	if (delta >= (1LL << 33) || delta <= -(1LL << 33))
+		return delta > 0 ? INT_MAX : INT_MIN;
+
+	delta = div64_s64(delta * NSEC_PER_SEC, (s64)dt);
+
+	return (s32)clamp_t(s64, delta, INT_MIN, INT_MAX);
+}
+
+/**
+ * idmf_enc_read - read and track an encoder
+ * @board:	the board
+ * @channel:	encoder channel
+ * @pos:	set to the unwrapped position, may be NULL
+ * @vel:	set to the velocity in counts per second, may be NULL
+ *
+ * The counter is read under the tracking lock, so concurrent readers
+ * record their readings in the order of their timestamps.
+ *
+ * This function returns MFC_CNT.
+ */
+static u32 idmf_enc_read(struct idmf_board *board, int channel, s64 *pos,
+		s32 *vel)
+{
+	struct idmf_enc *enc = &board->enc;
+	struct idmf_enc_chan *chan = &enc->chan[channel];
+	rtdm_lockctx_t lock_ctx;
+	u32 raw;
+	u32 slot;
+
+	rtdm_lock_get_irqsave(&enc->lock, lock_ctx);
+
+	raw = idmf_reg_read(board, MFC_CNT + channel * 0x40);
+	chan->timestamp = rtdm_clock_read();
+
+	if (chan->valid)
+		chan->position += (s32)(raw - chan->raw);
+	else
+		chan->position = (s32)raw;
+	chan->raw = raw;
+	chan->valid = 1;
+
+	chan->velocity = idmf_enc_velocity(enc, chan);
+
+	slot = (chan->head - 1) & (IDMF_ENC_HISTORY - 1);
+	if (!chan->head || chan->timestamp - chan->time[slot]
+			>= enc->window / IDMF_ENC_HISTORY) {
+		slot = chan->head++ & (IDMF_ENC_HISTORY - 1);
+		chan->time[slot] = chan->timestamp;
+		chan->pos[slot] = chan->position;
+	}
+
+	if (pos)
+		*pos = chan->position;
+	if (vel)
+		*vel = chan->velocity;
+
+	rtdm_lock_put_irqrestore(&enc->lock, lock_ctx);
+
+	return raw;
+}
+
+/**
+ * idmf_enc_track - configure and read the encoder tracking
+ * @board:	the board
+ * @arg:	user pointer to struct idmf_enc_track
+ */
+static int idmf_enc_track(struct idmf_board *board, void __user *arg)
+{
+	struct idmf_enc *enc = &board->enc;
+	struct idmf_enc_track track;
+	rtdm_lockctx_t lock_ctx;
+	int i;
+
+	if (copy_from_user(&track, arg, sizeof(track)))
+		return -EFAULT;
+
+	if (track.flags & IDMF_ENC_TRACK_CONFIG) {
+		if (!track.window_ns)
+			track.window_ns = IDMF_ENC_WINDOW_NS;
+
+		if (track.window_ns > NSEC_PER_SEC)
+			return -EINVAL;
+	}
+
+	rtdm_lock_get_irqsave(&enc->lock, lock_ctx);
+
+	if (track.flags & IDMF_ENC_TRACK_CONFIG) {
+		enc->window = track.window_ns;
+		for (i = 0; i < NUM_ENCS; i++) {
+			enc->chan[i].valid = 0;
+			enc->chan[i].head = 0;
+		}
+	}
+
+	track.window_ns = enc->window;
+
+	for (i = 0; i < NUM_ENCS; i++) {
+		track.timestamp[i] = enc->chan[i].valid ? enc->chan[i].timestamp : 0;
+		track.position[i] = enc->chan[i].position;
+		track.velocity[i] = enc->chan[i].velocity;
+	}
+
+	rtdm_lock_put_irqrestore(&enc->lock, lock_ctx);
+
+	if (copy_to_user(arg, &track, sizeof(track)))
+		return -EFAULT;
+
+	return 0;
+}
+
+/**
+ * idmf_reg_write_bypass - write a register and forget its cached value
+ * @board:	the board
+ * @offset:	register written bypassing idmf_out_commit and idmf_adc_ref
+ * @value:	the value
+ *
+ * Outputs are written and invalidated under the output lock, so a concurrent
+ * commit can not validate the shadow with a value the write replaces. A
+ * write of MFC_CNT restarts the tracking of the encoder after the write.
+ */
+static void idmf_reg_write_bypass(struct idmf_board *board, u32 offset,
+		u32 value)
+{
+	rtdm_lockctx_t lock_ctx;
+	u32 bit;
+
+	if (offset == ADC_REF || offset == ADC_DATA) {
+		idmf_reg_write(board, offset, value);
+		board->ref.valid = 0;
+		return;
+	}
+
+	if (offset >= MFC_CNT && offset < MFC_CNT + NUM_ENCS * 0x40
+			&& !((offset - MFC_CNT) % 0x40)) {
+		idmf_reg_write(board, offset, value);
+		idmf_enc_restart(board, (offset - MFC_CNT) / 0x40);
+		return;
+	}
+
+	if (offset >= DAC_VALUE && offset < DAC_VALUE + NUM_DACS * 0x04)
+		bit = IDMF_OUT_VALID_DAC((offset - DAC_VALUE) / 0x04);
+	else if (offset >= PRT_VALUE && offset < PRT_VALUE + NUM_PORTS * 0x04)
+		bit = IDMF_OUT_VALID_PORT((offset - PRT_VALUE) / 0x04);
+	else if (offset == GPIO_OUT)
+		bit = IDMF_OUT_VALID_GPIO;
+	else if (offset == BCT_LED)
+		bit = IDMF_OUT_VALID_LED;
+	else {
+		idmf_reg_write(board, offset, value);
+		return;
+	}
+
+	rtdm_lock_get_irqsave(&board->out.lock, lock_ctx);
+	idmf_reg_write(board, offset, value);
+	board->out.valid &= ~bit;
+	rtdm_lock_put_irqrestore(&board->out.lock, lock_ctx);
+}
+
+/* sets the resources of @b in @a */
+static void idmf_claim_add(struct idmf_claim *a, const struct idmf_claim *b)
+{
+	int i;
+
+	a->dac_mask |= b->dac_mask;
+	a->enc_mask |= b->enc_mask;
+	a->gpio_mask |= b->gpio_mask;
+	for (i = 0; i < NUM_PORTS; i++)
+		a->port_mask[i] |= b->port_mask[i];
+}
+
+/* clears the resources of @b in @a */
+static void idmf_claim_remove(struct idmf_claim *a, const struct idmf_claim *b)
+{
+	int i;
+
+	a->dac_mask &= ~b->dac_mask;
+	a->enc_mask &= ~b->enc_mask;
+	a->gpio_mask &= ~b->gpio_mask;
+	for (i = 0; i < NUM_PORTS; i++)
+		a->port_mask[i] &= ~b->port_mask[i];
+}
+
+static int idmf_claim_empty(const struct idmf_claim *a)
+{
+	int i;
+
+	if (a->dac_mask || a->enc_mask || a->gpio_mask)
+		return 0;
+
+	for (i = 0; i < NUM_PORTS; i++)
+		if (a->port_mask[i])
+			return 0;
+
+	return 1;
+}
+
+static int idmf_claim_overlap(const struct idmf_claim *a,
+		const struct idmf_claim *b)
+{
+	int i;
+
+	if ((a->dac_mask & b->dac_mask) || (a->enc_mask & b->enc_mask)
+			|| (a->gpio_mask & b->gpio_mask))
+		return 1;
+
+	for (i = 0; i < NUM_PORTS; i++)
+		if (a->port_mask[i] & b->port_mask[i])
+			return 1;
+
+	return 0;
+}
+
+/**
+ * idmf_claim_check - check the resources written through an open file
+ * @board:	the board
+ * @ctx:	the open file
+ * @use:	the resources to be written
+ *
+ * This function returns 0 or -EACCES if another open file claimed one of
+ * the resources.
+ */
+static int idmf_claim_check(struct idmf_board *board, struct idmf_ctx *ctx,
+		const struct idmf_claim *use)
+{
+	struct idmf_claim others;
+	rtdm_lockctx_t lock_ctx;
+
+	rtdm_lock_get_irqsave(&board->owner.lock, lock_ctx);
+	others = board->owner.claimed;
+	idmf_claim_remove(&others, &ctx->claim);
+	rtdm_lock_put_irqrestore(&board->owner.lock, lock_ctx);
+
+	return idmf_claim_overlap(&others, use) ? -EACCES : 0;
+}
+
+/*
+ * adds the resources written by a write of a register to @use, a register of
+ * several pins uses all of them; returns 0 if the register holds none. The
+ * direction registers count as writes of their pins, since turning a claimed
+ * output into an input defeats the claim as well.
+ */
+static int idmf_claim_reg(struct idmf_claim *use, u32 offset)
+{
+	int i;
+
+	if (offset >= DAC_VALUE && offset < DAC_VALUE + NUM_DACS * 0x04)
+		use->dac_mask |= 1 << ((offset - DAC_VALUE) / 0x04);
+	else if (offset >= PRT_VALUE && offset < PRT_VALUE + NUM_PORTS * 0x04)
+		use->port_mask[(offset - PRT_VALUE) / 0x04] = 0xFF;
+	else if (offset == PRT_CTRL)
+		for (i = 0; i < NUM_PORTS; i++)
+			use->port_mask[i] = 0xFF;
+	else if (offset == GPIO_OUT || offset == GPIO_DIR0
+			|| offset == GPIO_DIR1)
+		use->gpio_mask = 0xFFFFFFFF;
+	else if (offset >= MFC_CCR && offset < MFC_CCR + NUM_ENCS * 0x40)
+		use->enc_mask |= 1 << ((offset - MFC_CCR) / 0x40);
+	else
+		return 0;
+
+	return 1;
+}
+
+/* checks a write of a register */
+static int idmf_claim_check_reg(struct idmf_board *board, struct idmf_ctx *ctx,
+		u32 offset)
+{
+	struct idmf_claim use;
+
+	memset(&use, 0, sizeof(use));
+
+	if (!idmf_claim_reg(&use, offset))
+		return 0;
+
+	return idmf_claim_check(board, ctx, &use);
+}
+
+static int idmf_claim_valid(const struct idmf_claim *claim)
+{
+	return !(claim->dac_mask & ~((1 << NUM_DACS) - 1))
+			&& !(claim->enc_mask & ~((1 << NUM_ENCS) - 1))
+			&& !(claim->gpio_mask & ~((1 << NUM_GPIOS) - 1))
+			&& !claim->reserved;
+}
+
+/**
+ * idmf_claim - claim resources for an open file
+ * @board:	the board
+ * @ctx:	the open file
+ * @arg:	user pointer to struct idmf_claim
+ *
+ * All resources are claimed or, if one of them is claimed by another open
+ * file, none with -EBUSY. Writes through a mapped register window cannot be
+ * checked, so nothing can be claimed while the window is mapped. The claims
+ * of the file are copied back.
+ */
+static int idmf_claim(struct idmf_board *board, struct idmf_ctx *ctx,
+		void __user *arg)
+{
+	struct idmf_claim claim;
+	struct idmf_claim others;
+	rtdm_lockctx_t lock_ctx;
+	int err = 0;
+
+	if (copy_from_user(&claim, arg, sizeof(claim)))
+		return -EFAULT;
+
+	if (!idmf_claim_valid(&claim))
+		return -EINVAL;
+
+	rtdm_lock_get_irqsave(&board->owner.lock, lock_ctx);
+
+	others = board->owner.claimed;
+	idmf_claim_remove(&others, &ctx->claim);
+
+	if (atomic_read(&board->map_count) > 0
+			|| idmf_claim_overlap(&others, &claim))
+		err = -EBUSY;
+	else {
+		idmf_claim_add(&ctx->claim, &claim);
+		idmf_claim_add(&board->owner.claimed, &claim);
+	}
+
+	claim = ctx->claim;
+
+	rtdm_lock_put_irqrestore(&board->owner.lock, lock_ctx);
+
+	if (copy_to_user(arg, &claim, sizeof(claim)))
+		return -EFAULT;
+
+	return err;
+}
+
+/**
+ * idmf_release - release resources of an open file
+ * @board:	the board
+ * @ctx:	the open file
+ * @arg:	user pointer to struct idmf_claim
+ *
+ * Resources not claimed by the file are ignored. The remaining claims of
+ * the file are copied back.
+ */
+static int idmf_release(struct idmf_board *board, struct idmf_ctx *ctx,
+		void __user *arg)
+{
+	struct idmf_claim claim;
+	struct idmf_claim held;
+	rtdm_lockctx_t lock_ctx;
+
+	if (copy_from_user(&claim, arg, sizeof(claim)))
+		return -EFAULT;
+
+	if (!idmf_claim_valid(&claim))
+		return -EINVAL;
+
+	rtdm_lock_get_irqsave(&board->owner.lock, lock_ctx);
+
+	/* the released resources are those the file loses */
+	held = ctx->claim;
+	idmf_claim_remove(&ctx->claim, &claim);
+	idmf_claim_remove(&held, &ctx->claim);
+	idmf_claim_remove(&board->owner.claimed, &held);
+
+	claim = ctx->claim;
+
+	rtdm_lock_put_irqrestore(&board->owner.lock, lock_ctx);
+
+	if (copy_to_user(arg, &claim, sizeof(claim)))
+		return -EFAULT;
+
+	return 0;
+}
+
+/**
+ * idmf_xact - execute a batch of register operations
+ * @board:	the board
+ * @arg:	user pointer to struct idmf_xact
+ *
+ * The operations are copied in chunks of IDMF_XACT_CHUNK, executed in order
+ * and the chunk is copied back so that read operations return their values.
+ * Execution stops at the first invalid operation or write of a resource
+ * claimed by another open file; operations of preceding chunks have already
+ * been executed at that point.
+ */
+static int idmf_xact(struct idmf_board *board, struct idmf_ctx *ctx,
+		void __user *arg)
+{
+	struct idmf_xact xact;
+	struct idmf_reg_op ops[IDMF_XACT_CHUNK];
+	struct idmf_reg_op __user *uops;
+	u32 done, count, i;
+	int err;
+
+	if (copy_from_user(&xact, arg, sizeof(xact)))
+		return -EFAULT;
+
+	if (xact.count > IDMF_XACT_MAX)
+		return -EINVAL;
+
+	uops = (struct idmf_reg_op __user *)(unsigned long)xact.ops;
+
+	for (done = 0; done < xact.count; done += count) {
+		count = min_t(u32, xact.count - done, IDMF_XACT_CHUNK);
+
+		if (copy_from_user(ops, uops + done, count * sizeof(ops[0])))
+			return -EFAULT;
+
+		for (i = 0; i < count; i++) {
+			if (!idmf_reg_valid(ops[i].offset))
+				return -EINVAL;
+
+			if (ops[i].op != IDMF_OP_WRITE)
+				continue;
+
+			err = idmf_claim_check_reg(board, ctx, ops[i].offset);
+			if (err)
+				return err;
+		}
+
+		for (i = 0; i < count; i++) {
+			switch (ops[i].op) {
+			case IDMF_OP_READ:
+				ops[i].value = idmf_reg_read(board, ops[i].offset);
+				break;
+			case IDMF_OP_WRITE:
+				idmf_reg_write_bypass(board, ops[i].offset,
+						ops[i].value);
+				break;
+			default:
+				return -EINVAL;
+			}
+		}
+
+		if (copy_to_user(uops + done, ops, count * sizeof(ops[0])))
+			return -EFAULT;
+	}
+
+	return 0;
+}
+
+/* drives the BCT_ADC request line, the read back flushes the posted write */
+static inline void idmf_adc_phase(struct idmf_board *board, u32 value)
+{
+	idmf_reg_write(board, BCT_ADC, value);
+	idmf_reg_read(board, BCT_ADC);
+}
+
+static inline void idmf_adc_drain(struct idmf_board *board, s16 *value)
+{
+	int i;
+
+	for (i = 0; i < NUM_ADCS; i++)
+		value[idmf_adc_order[i]] = (s16)idmf_reg_read(board, ADC_DATA);
+}
+
+/*
+ * waits without the ADC lock until a running conversion has completed,
+ * idmf_adc_timer needs the lock to finish it; returns 0 or -EBUSY once
+ * @deadline has passed. A realtime caller sleeps, so an owner of lower
+ * priority can complete its conversion.
+ */
+static int idmf_adc_wait_idle(struct idmf_board *board,
+		nanosecs_abs_t deadline)
+{
+	while (ACCESS_ONCE(board->adc.busy)) {
+		if (rtdm_clock_read() >= deadline)
+			return -EBUSY;
+
+		if (rtdm_in_rt_context())
+			rtdm_task_sleep(IDMF_ADC_POLL_NS);
+		else
+			rtdm_task_busy_sleep(IDMF_ADC_POLL_NS);
+	}
+
+	return 0;
+}
+
+/*
+ * marks the ADC of a board busy for a sequence run without its lock, once a
+ * running conversion has completed; returns 0 or -EBUSY once @deadline has
+ * passed
+ */
+static int idmf_adc_claim(struct idmf_board *board, nanosecs_abs_t deadline)
+{
+	rtdm_lockctx_t lock_ctx;
+	int err;
+
+	for (;;) {
+		rtdm_lock_get_irqsave(&board->adc_lock, lock_ctx);
+		if (!board->adc.busy) {
+			board->adc.busy = 1;
+			rtdm_lock_put_irqrestore(&board->adc_lock, lock_ctx);
+			return 0;
+		}
+		rtdm_lock_put_irqrestore(&board->adc_lock, lock_ctx);
+
+		err = idmf_adc_wait_idle(board, deadline);
+		if (err)
+			return err;
+	}
+}
+
+static void idmf_adc_release(struct idmf_board *board)
+{
+	rtdm_lockctx_t lock_ctx;
+
+	rtdm_lock_get_irqsave(&board->adc_lock, lock_ctx);
+	board->adc.busy = 0;
+	rtdm_lock_put_irqrestore(&board->adc_lock, lock_ctx);
+}
+
+/**
+ * idmf_adc_convert - run a complete ADC conversion
+ * @board:	the board
+ * @value:	the samples in channel order
+ *
+ * The conversion is requested and started through BCT_ADC and the samples
+ * are drained from ADC_DATA. The ADC is claimed for the sequence, which
+ * busy waits with interrupts enabled, so its timing does not depend on the
+ * caller being scheduled. A running conversion is completed first.
+ *
+ * This function returns 0 or -EBUSY if the running conversion did not
+ * complete within IDMF_ADC_IDLE_NS.
+ */
+static int idmf_adc_convert(struct idmf_board *board, s16 *value)
+{
+	int err;
+
+	err = idmf_adc_claim(board, rtdm_clock_read() + IDMF_ADC_IDLE_NS);
+	if (err)
+		return err;
+
+	idmf_adc_phase(board, 0x01);
+	rtdm_task_busy_sleep(IDMF_ADC_REQUEST_NS);
+
+	idmf_adc_phase(board, 0x00);
+	rtdm_task_busy_sleep(IDMF_ADC_CONVERT_NS);
+
+	idmf_adc_drain(board, value);
+
+	idmf_adc_release(board);
+
+	return 0;
+}
+
+static int idmf_adc_convert_user(struct idmf_board *board, void __user *arg)
+{
+	struct idmf_adc_frame frame;
+	int err;
+
+	frame.timestamp = rtdm_clock_read();
+	err = idmf_adc_convert(board, frame.value);
+	if (err)
+		return err;
+
+	if (copy_to_user(arg, &frame, sizeof(frame)))
+		return -EFAULT;
+
+	return 0;
+}
+
+/**
+ * idmf_adc_timer - run the next step of an asynchronous conversion
+ * @timer:	the timer of struct idmf_adc_async
+ *
+ * The steps wait for the same times as idmf_adc_convert, but the caller
+ * and the CPU are free in between.
+ */
+static void idmf_adc_timer(rtdm_timer_t *timer)
+{
+	struct idmf_adc_async *adc =
+			container_of(timer, struct idmf_adc_async, timer);
+	struct idmf_board *board = container_of(adc, struct idmf_board, adc);
+	rtdm_lockctx_t lock_ctx;
+	s16 value[NUM_ADCS];
+
+	if (adc->phase == IDMF_ADC_PHASE_START) {
+		idmf_adc_phase(board, 0x00);
+		adc->phase = IDMF_ADC_PHASE_DRAIN;
+		rtdm_timer_start_in_handler(timer, IDMF_ADC_CONVERT_NS, 0,
+				RTDM_TIMERMODE_RELATIVE);
+		return;
+	}
+
+	idmf_adc_drain(board, value);
+
+	rtdm_lock_get_irqsave(&board->adc_lock, lock_ctx);
+	adc->frame.timestamp = adc->timestamp;
+	memcpy(adc->frame.value, value, sizeof(value));
+	adc->done = adc->seq;
+	adc->busy = 0;
+	rtdm_lock_put_irqrestore(&board->adc_lock, lock_ctx);
+
+	rtdm_event_signal(&adc->ready);
+
+	smp_mb();
+	if (atomic_read(&adc->nrt_waiters))
+		rtdm_nrtsig_pend(&adc->nrt_ready);
+}
+
+static void idmf_adc_nrt_ready(rtdm_nrtsig_t nrt_sig, void *arg)
+{
+	struct idmf_adc_async *adc = arg;
+
+	wake_up_interruptible(&adc->nrt_wait);
+}
+
+static int idmf_adc_init(struct idmf_board *board)
+{
+	struct idmf_adc_async *adc = &board->adc;
+	int err;
+
+	err = rtdm_nrtsig_init(&adc->nrt_ready, idmf_adc_nrt_ready, adc);
+	if (err)
+		return err;
+
+	err = rtdm_timer_init(&adc->timer, idmf_adc_timer, "idmf_adc");
+	if (err) {
+		rtdm_nrtsig_destroy(&adc->nrt_ready);
+		return err;
+	}
+
+	rtdm_event_init(&adc->ready, 0);
+	init_waitqueue_head(&adc->nrt_wait);
+	atomic_set(&adc->nrt_waiters, 0);
+
+	return 0;
+}
+
+static void idmf_adc_cleanup(struct idmf_board *board)
+{
+	struct idmf_adc_async *adc = &board->adc;
+
+	rtdm_timer_destroy(&adc->timer);
+	rtdm_event_destroy(&adc->ready);
+	rtdm_nrtsig_destroy(&adc->nrt_ready);
+}
+
+/**
+ * idmf_adc_submit - start an asynchronous ADC conversion
+ * @board:	the board
+ * @ctx:	the open file
+ * @arg:	user pointer to the __u32 receiving the sequence number
+ *
+ * The request line is raised and the request returns, the timer finishes
+ * the conversion. Only one conversion runs at a time, a second one fails
+ * with -EBUSY, as does one submitted during a synchronous conversion or a
+ * snapshot.
+ */
+static int idmf_adc_submit(struct idmf_board *board, struct idmf_ctx *ctx,
+		void __user *arg)
+{
+	struct idmf_adc_async *adc = &board->adc;
+	rtdm_lockctx_t lock_ctx;
+	u32 seq;
+	int err;
+
+	rtdm_lock_get_irqsave(&board->adc_lock, lock_ctx);
+
+	if (adc->busy) {
+		rtdm_lock_put_irqrestore(&board->adc_lock, lock_ctx);
+		return -EBUSY;
+	}
+
+	adc->busy = 1;
+	adc->phase = IDMF_ADC_PHASE_START;
+	if (!++adc->seq)
+		adc->seq++;
+	seq = adc->seq;
+	adc->timestamp = rtdm_clock_read();
+
+	idmf_adc_phase(board, 0x01);
+
+	rtdm_lock_put_irqrestore(&board->adc_lock, lock_ctx);
+
+	err = rtdm_timer_start(&adc->timer, IDMF_ADC_REQUEST_NS, 0,
+			RTDM_TIMERMODE_RELATIVE);
+	if (err) {
+		rtdm_lock_get_irqsave(&board->adc_lock, lock_ctx);
+		idmf_adc_phase(board, 0x00);
+		adc->busy = 0;
+		rtdm_lock_put_irqrestore(&board->adc_lock, lock_ctx);
+		return err;
+	}
+
+	ctx->adc_seq = seq;
+
+	if (put_user(seq, (u32 __user *)arg))
+		return -EFAULT;
+
+	return 0;
+}
+
+/* conversion @seq or a later one has completed */
+static inline int idmf_adc_done(struct idmf_adc_async *adc, u32 seq)
+{
+	return (s32)(ACCESS_ONCE(adc->done) - seq) >= 0;
+}
+
+static int idmf_adc_wait_done(struct idmf_adc_async *adc, u32 seq,
+		nanosecs_rel_t timeout)
+{
+	rtdm_toseq_t timeout_seq;
+	long ret;
+
+	if (rtdm_in_rt_context()) {
+		rtdm_toseq_init(&timeout_seq, timeout);
+
+		while (!idmf_adc_done(adc, seq)) {
+			ret = rtdm_event_timedwait(&adc->ready, timeout, &timeout_seq);
+			if (ret)
+				return ret;
+		}
+
+		return 0;
+	}
+
+	if (timeout < 0)
+		return idmf_adc_done(adc, seq) ? 0 : -EWOULDBLOCK;
+
+	atomic_inc(&adc->nrt_waiters);
+	smp_mb();
+
+	if (timeout == 0) {
+		ret = wait_event_interruptible(adc->nrt_wait,
+				idmf_adc_done(adc, seq));
+	} else {
+		ret = wait_event_interruptible_timeout(adc->nrt_wait,
+				idmf_adc_done(adc, seq),
+				msecs_to_jiffies(div_u64(timeout + 999999, 1000000)));
+		ret = ret > 0 ? 0 : (ret ? ret : -ETIMEDOUT);
+	}
+
+	atomic_dec(&adc->nrt_waiters);
+
+	return ret;
+}
+
+/**
+ * idmf_adc_wait - wait for an asynchronous ADC conversion
+ * @board:	the board
+ * @ctx:	the open file
+ * @arg:	user pointer to struct idmf_adc_wait
+ *
+ * The request waits for the conversion last submitted through @ctx and
+ * returns the samples of the last completed conversion.
+ */
+static int idmf_adc_wait(struct idmf_board *board, struct idmf_ctx *ctx,
+		void __user *arg)
+{
+	struct idmf_adc_async *adc = &board->adc;
+	struct idmf_adc_wait req;
+	rtdm_lockctx_t lock_ctx;
+	int err;
+
+	if (copy_from_user(&req, arg, sizeof(req)))
+		return -EFAULT;
+
+	if (!ctx->adc_seq)
+		return -EINVAL;
+
+	err = idmf_adc_wait_done(adc, ctx->adc_seq, req.timeout);
+	if (err)
+		return err;
+
+	rtdm_lock_get_irqsave(&board->adc_lock, lock_ctx);
+	req.seq = adc->done;
+	req.frame = adc->frame;
+	rtdm_lock_put_irqrestore(&board->adc_lock, lock_ctx);
+
+	if (copy_to_user(arg, &req, sizeof(req)))
+		return -EFAULT;
+
+	return 0;
+}
+
+/* ADC_REF serial interface lines */
+#define IDMF_REF_CLK		0x01
+#define IDMF_REF_LOAD		0x02
+#define IDMF_REF_DATA		0x04
+
+/* ADC_DATA value selecting the reference programming, and word prefixes */
+#define IDMF_REF_SELECT		0x0C
+#define IDMF_REF_INA		0x00100000
+#define IDMF_REF_ADC		0x00240000
+
+/**
+ * idmf_ref_word - shift a 24 bit word into the reference DAC
+ * @board:	the board
+ * @value:	the word, MSB first
+ *
+ * Each bit is read back after its falling clock edge, so the posted writes
+ * reach the board and the clock runs at the pace of the bus.
+ */
+static void idmf_ref_word(struct idmf_board *board, u32 value)
+{
+	u32 data;
+	int i;
+
+	idmf_reg_write(board, ADC_REF, 0x00);
+
+	for (i = 23; i >= 0; i--) {
+		data = (value & (1 << i)) ? IDMF_REF_DATA : 0;
+
+		idmf_reg_write(board, ADC_REF, data | IDMF_REF_CLK);
+		idmf_reg_write(board, ADC_REF, data);
+		idmf_reg_read(board, ADC_REF);
+	}
+
+	idmf_reg_write(board, ADC_REF, IDMF_REF_LOAD);
+	idmf_reg_read(board, ADC_REF);
+}
+
+/**
+ * idmf_adc_ref - program the references of the ADC
+ * @board:	the board
+ * @arg:	user pointer to struct idmf_adc_ref
+ *
+ * Words whose value is already programmed are skipped, nothing is written
+ * when both are. The sequence is not run with interrupts disabled; a
+ * concurrent caller gets -EBUSY instead.
+ */
+static int idmf_adc_ref(struct idmf_board *board, void __user *arg)
+{
+	struct idmf_adc_ref ref;
+	struct idmf_ref *cache = &board->ref;
+	int force;
+
+	if (copy_from_user(&ref, arg, sizeof(ref)))
+		return -EFAULT;
+
+	if (test_and_set_bit(0, &cache->busy))
+		return -EBUSY;
+
+	force = !cache->valid || (ref.flags & IDMF_REF_FORCE);
+
+	if (force || cache->refina != ref.refina
+			|| cache->refadc != ref.refadc) {
+		cache->valid = 0;
+
+		idmf_reg_write(board, ADC_DATA, IDMF_REF_SELECT);
+
+		if (force || cache->refina != ref.refina)
+			idmf_ref_word(board, IDMF_REF_INA | ref.refina);
+
+		if (force || cache->refadc != ref.refadc)
+			idmf_ref_word(board, IDMF_REF_ADC | ref.refadc);
+
+		cache->refina = ref.refina;
+		cache->refadc = ref.refadc;
+		cache->valid = 1;
+	}
+
+	smp_mb__before_clear_bit();
+	clear_bit(0, &cache->busy);
+
+	return 0;
+}
+
+/**
+ * idmf_trace_ctl - turn the register access trace on or off
+ * @board:	the board
+ * @arg:	user pointer to struct idmf_trace_ctl
+ *
+ * The ring is allocated on the first enable and kept until the board is
+ * removed, so tracing can be toggled while other callers access the board.
+ */
+static int idmf_trace_ctl(struct idmf_board *board, void __user *arg)
+{
+	struct idmf_trace *trace = &board->trace;
+	struct idmf_trace_ctl ctl;
+	struct idmf_trace_entry *ring;
+	int i;
+
+	if (rtdm_in_rt_context())
+		return -ENOSYS;
+
+	if (copy_from_user(&ctl, arg, sizeof(ctl)))
+		return -EFAULT;
+
+	if ((ctl.flags & IDMF_TRACE_ENABLE) && !trace->ring) {
+		ring = vmalloc(IDMF_TRACE_FRAMES * sizeof(*ring));
+		if (!ring)
+			return -ENOMEM;
+
+		for (i = 0; i < IDMF_TRACE_FRAMES; i++)
+			ring[i].seq = IDMF_TRACE_BUSY;
+
+		/* a concurrent first enable may have won */
+		if (cmpxchg(&trace->ring, NULL, ring))
+			vfree(ring);
+	}
+
+	/* the ring is in place before the first writer can see the flag */
+	smp_wmb();
+	ACCESS_ONCE(trace->enabled) = !!(ctl.flags & IDMF_TRACE_ENABLE);
+
+	ctl.head = (u32)atomic_read(&trace->head);
+
+	if (copy_to_user(arg, &ctl, sizeof(ctl)))
+		return -EFAULT;
+
+	return 0;
+}
+
+/**
+ * idmf_trace_dump - copy trace entries to user space
+ * @board:	the board
+ * @arg:	user pointer to struct idmf_trace_dump
+ *
+ * Each entry is copied once its sequence number shows it complete and
+ * checked again afterwards, entries overwritten in between are counted as
+ * lost. Writers are never held up.
+ */
+static int idmf_trace_dump(struct idmf_board *board, void __user *arg)
+{
+	struct idmf_trace *trace = &board->trace;
+	struct idmf_trace_dump dump;
+	struct idmf_trace_entry entry, *slot;
+	struct idmf_trace_entry __user *entries;
+	u32 head, seq, seq_end, count = 0;
+
+	if (copy_from_user(&dump, arg, sizeof(dump)))
+		return -EFAULT;
+
+	if (!trace->ring)
+		return -ENODEV;
+
+	entries = (struct idmf_trace_entry __user *)(unsigned long)dump.entries;
+
+	head = (u32)atomic_read(&trace->head);
+	seq = dump.start;
+	dump.lost = 0;
+
+	/* entries older than the ring are gone, a start ahead waits for head */
+	if ((s32)(head - seq) > IDMF_TRACE_FRAMES) {
+		dump.lost = head - IDMF_TRACE_FRAMES - seq;
+		seq = head - IDMF_TRACE_FRAMES;
+	} else if ((s32)(head - seq) < 0) {
+		seq = head;
+	}
+
+	while (seq != head && count < dump.count) {
+		/* skipped by the writers when the sequence numbers wrap */
+		if (unlikely(seq == IDMF_TRACE_BUSY)) {
+			seq++;
+			continue;
+		}
+
+		slot = &trace->ring[seq & (IDMF_TRACE_FRAMES - 1)];
+
+		seq_end = ACCESS_ONCE(slot->seq);
+		if (seq_end == IDMF_TRACE_BUSY || (s32)(seq_end - seq) < 0)
+			break;
+
+		smp_rmb();
+		entry = *slot;
+		smp_rmb();
+
+		if (seq_end != seq || ACCESS_ONCE(slot->seq) != seq) {
+			dump.lost++;
+			seq++;
+			continue;
+		}
+
+		if (copy_to_user(&entries[count], &entry, sizeof(entry)))
+			return -EFAULT;
+
+		count++;
+		seq++;
+	}
+
+	dump.count = count;
+	dump.start = seq;
+
+	if (copy_to_user(arg, &dump, sizeof(dump)))
+		return -EFAULT;
+
+	return 0;
+}
+
+/* default priority of the acquisition task */
+#define IDMF_ACQ_PRIORITY	80
+
+/* called with accum->lock held */
+static void idmf_accum_reset(struct idmf_accum *accum)
+{
+	int i;
+
+	accum->count = 0;
+	accum->first = 0;
+	accum->last = 0;
+
+	for (i = 0; i < NUM_ADCS; i++) {
+		accum->sum[i] = 0;
+		accum->min[i] = SHRT_MAX;
+		accum->max[i] = SHRT_MIN;
+	}
+}
+
+/**
+ * idmf_adc_oversample - run several ADC conversions and accumulate them
+ * @board:	the board
+ * @count:	number of conversions, 0 converts once
+ * @value:	mean of the samples in channel order
+ *
+ * The conversions are merged into the accumulators of the board after the
+ * last one, so readers of the accumulators never wait for a conversion.
+ */
+static int idmf_adc_oversample(struct idmf_board *board, u32 count,
+		s16 *value)
+{
+	struct idmf_accum *accum = &board->accum;
+	rtdm_lockctx_t lock_ctx;
+	s16 conv[NUM_ADCS];
+	s16 min[NUM_ADCS];
+	s16 max[NUM_ADCS];
+	s32 sum[NUM_ADCS];
+	u64 first;
+	u32 n;
+	int i;
+
+	if (!count)
+		count = 1;
+
+	first = rtdm_clock_read();
+
+	for (n = 0; n < count; n++) {
+		if (idmf_adc_convert(board, conv))
+			break;
+
+		for (i = 0; i < NUM_ADCS; i++) {
+			if (!n) {
+				sum[i] = min[i] = max[i] = conv[i];
+				continue;
+			}
+
+			sum[i] += conv[i];
+			if (conv[i] < min[i])
+				min[i] = conv[i];
+			if (conv[i] > max[i])
+				max[i] = conv[i];
+		}
+	}
+
+	/* an asynchronous conversion keeps the ADC for the rest of the period */
+	if (!n)
+		return -EBUSY;
+	count = n;
+
+	/* the mean is rounded to the nearest code */
+	for (i = 0; i < NUM_ADCS; i++)
+		value[i] = (s16)((sum[i] + (sum[i] < 0 ? -(s32)count : (s32)count)
+				/ 2) / (s32)count);
+
+	rtdm_lock_get_irqsave(&accum->lock, lock_ctx);
+
+	if (!accum->count)
+		accum->first = first;
+	accum->last = rtdm_clock_read();
+	accum->count += count;
+
+	for (i = 0; i < NUM_ADCS; i++) {
+		accum->sum[i] += sum[i];
+		if (min[i] < accum->min[i])
+			accum->min[i] = min[i];
+		if (max[i] > accum->max[i])
+			accum->max[i] = max[i];
+	}
+
+	rtdm_lock_put_irqrestore(&accum->lock, lock_ctx);
+
+	return 0;
+}
+
+/**
+ * idmf_adc_accum - read the ADC accumulators
+ * @board:	the board
+ * @arg:	user pointer to struct idmf_adc_accum
+ *
+ * With IDMF_ACCUM_RESET the accumulators are read and cleared atomically,
+ * so no conversion is lost or counted twice between two calls.
+ */
+static int idmf_adc_accum(struct idmf_board *board, void __user *arg)
+{
+	struct idmf_accum *accum = &board->accum;
+	struct idmf_adc_accum result;
+	rtdm_lockctx_t lock_ctx;
+	int i;
+
+	if (copy_from_user(&result, arg, sizeof(result)))
+		return -EFAULT;
+
+	rtdm_lock_get_irqsave(&accum->lock, lock_ctx);
+
+	result.count = accum->count;
+	result.first = accum->first;
+	result.last = accum->last;
+
+	for (i = 0; i < NUM_ADCS; i++) {
+		result.sum[i] = accum->sum[i];
+		result.min[i] = accum->min[i];
+		result.max[i] = accum->max[i];
+	}
+
+	if (result.flags & IDMF_ACCUM_RESET)
+		idmf_accum_reset(accum);
+
+	rtdm_lock_put_irqrestore(&accum->lock, lock_ctx);
+
+	if (copy_to_user(arg, &result, sizeof(result)))
+		return -EFAULT;
+
+	return 0;
+}
+
+/**
+ * idmf_capture - sample the inputs of a board
+ * @board:	the board
+ * @config:	sources to be sampled
+ * @sample:	the sample
+ */
+static void idmf_capture(struct idmf_board *board,
+		const struct idmf_acq_config *config, struct idmf_sample *sample)
+{
+	int i;
+
+	sample->timestamp = rtdm_clock_read();
+	sample->flags = config->flags & (IDMF_ACQ_ADC | IDMF_ACQ_GPIO);
+	sample->enc_mask = config->enc_mask & ((1 << NUM_ENCS) - 1);
+	sample->port_mask = config->port_mask & ((1 << NUM_PORTS) - 1);
+
+	if ((sample->flags & IDMF_ACQ_ADC) &&
+			idmf_adc_oversample(board, config->oversample, sample->adc))
+		sample->flags &= ~IDMF_ACQ_ADC;
+
+	for (i = 0; i < NUM_ENCS; i++)
+		if (sample->enc_mask & (1 << i))
+			sample->enc[i] = (s32)idmf_enc_read(board, i,
+					&sample->enc_pos[i], &sample->enc_vel[i]);
+
+	for (i = 0; i < NUM_PORTS; i++)
+		if (sample->port_mask & (1 << i))
+			sample->port[i] = (u8)idmf_reg_read(board, PRT_VALUE + i * 0x04);
+
+	if (sample->flags & IDMF_ACQ_GPIO)
+		sample->gpio = idmf_reg_read(board, GPIO_IN);
+}
+
+/* reads all inputs of a board except for the ADC */
+static void idmf_snapshot_inputs(struct idmf_board *board,
+		struct idmf_snapshot *snap)
+{
+	int i;
+
+	for (i = 0; i < NUM_ENCS; i++)
+		snap->enc[i] = (s32)idmf_enc_read(board, i, NULL, NULL);
+
+	for (i = 0; i < NUM_PORTS; i++)
+		snap->port[i] = (u8)idmf_reg_read(board, PRT_VALUE + i * 0x04);
+
+	snap->gpio = idmf_reg_read(board, GPIO_IN);
+	snap->enc_alarm[0] = idmf_reg_read(board, ENC_ALARM0);
+	snap->enc_alarm[1] = idmf_reg_read(board, ENC_ALARM1);
+	snap->enc_pwrstat = idmf_reg_read(board, ENC_PWRSTAT);
+}
+
+/**
+ * idmf_snapshot - sample all inputs of a board
+ * @board:	the board
+ * @arg:	user pointer to struct idmf_snapshot
+ *
+ * The ADC conversion runs first, all other inputs are read back to back
+ * right after it.
+ */
+static int idmf_snapshot(struct idmf_board *board, void __user *arg)
+{
+	struct idmf_snapshot snap;
+	int err;
+
+	memset(&snap, 0, sizeof(snap));
+
+	snap.timestamp = rtdm_clock_read();
+	err = idmf_adc_convert(board, snap.adc);
+	if (err)
+		return err;
+
+	idmf_snapshot_inputs(board, &snap);
+
+	if (copy_to_user(arg, &snap, sizeof(snap)))
+		return -EFAULT;
+
+	return 0;
+}
+
+/**
+ * idmf_group_snapshot - sample all inputs of all boards
+ * @arg:	user pointer to struct idmf_group_frame
+ *
+ * The boards are taken from the list under its lock and removal waits until
+ * the snapshot is done with them. The ADCs of all boards are claimed in list
+ * order, pending asynchronous conversions are completed first. The request
+ * and start edges are driven on all boards back to back, the other inputs are
+ * read during the conversion time and the remaining conversion time is
+ * waited for before the samples are drained. Interrupts stay enabled, the
+ * claims keep other conversions off the boards.
+ */
+static int idmf_group_snapshot(void __user *arg)
+{
+	struct idmf_snapshot snap[IDMF_GROUP_MAX];
+	struct idmf_board *boards[IDMF_GROUP_MAX];
+	struct idmf_board *board;
+	struct idmf_group_frame __user *frame = arg;
+	nanosecs_abs_t timestamp, started, elapsed, deadline;
+	rtdm_lockctx_t lock_ctx;
+	u32 count = 0;
+	u32 claimed;
+	u32 i;
+	int err = 0;
+
+	rtdm_lock_get_irqsave(&idmf_list_lock, lock_ctx);
+	list_for_each_entry(board, &idmf_list, list) {
+		if (count == IDMF_GROUP_MAX)
+			break;
+		atomic_inc(&board->snapshots);
+		boards[count++] = board;
+	}
+	rtdm_lock_put_irqrestore(&idmf_list_lock, lock_ctx);
+
+	if (!count)
+		return -ENODEV;
+
+	memset(snap, 0, count * sizeof(snap[0]));
+
+	deadline = rtdm_clock_read() + IDMF_ADC_IDLE_NS;
+
+	for (claimed = 0; claimed < count; claimed++) {
+		err = idmf_adc_claim(boards[claimed], deadline);
+		if (err)
+			goto release;
+	}
+
+	timestamp = rtdm_clock_read();
+
+	for (i = 0; i < count; i++)
+		idmf_adc_phase(boards[i], 0x01);
+	rtdm_task_busy_sleep(IDMF_ADC_REQUEST_NS);
+
+	for (i = 0; i < count; i++)
+		idmf_adc_phase(boards[i], 0x00);
+	started = rtdm_clock_read();
+
+	for (i = 0; i < count; i++) {
+		snap[i].timestamp = timestamp;
+		idmf_snapshot_inputs(boards[i], &snap[i]);
+	}
+
+	elapsed = rtdm_clock_read() - started;
+	if (elapsed < IDMF_ADC_CONVERT_NS)
+		rtdm_task_busy_sleep(IDMF_ADC_CONVERT_NS - elapsed);
+
+	for (i = 0; i < count; i++)
+		idmf_adc_drain(boards[i], snap[i].adc);
+
+	release:
+	while (claimed--)
+		idmf_adc_release(boards[claimed]);
+
+	for (i = 0; i < count; i++) {
+		smp_mb__before_atomic_dec();
+		atomic_dec(&boards[i]->snapshots);
+	}
+
+	if (err)
+		return err;
+
+	if (copy_to_user(frame->board, snap, count * sizeof(snap[0])))
+		return -EFAULT;
+
+	if (put_user(timestamp, &frame->timestamp) ||
+			put_user(count, &frame->boards))
+		return -EFAULT;
+
+	return 0;
+}
+
+/**
+ * idmf_out_commit - write the outputs of a board
+ * @board:	the board
+ * @arg:	user pointer to struct idmf_out_frame
+ *
+ * The DAC values are written and latched first, followed by the ports,
+ * GPIO_OUT and BCT_LED. Registers whose shadow matches the new value are
+ * skipped. Writes through the register window mapped into user space are
+ * not seen by the shadow, IDMF_OUT_FORCE has to be used after them.
+ */
+static int idmf_out_commit(struct idmf_board *board, struct idmf_ctx *ctx,
+		void __user *arg)
+{
+	struct idmf_out_frame frame;
+	struct idmf_out *out = &board->out;
+	struct idmf_claim use;
+	rtdm_lockctx_t lock_ctx;
+	u32 valid;
+	int latch = 0;
+	int err;
+	int i;
+
+	if (copy_from_user(&frame, arg, sizeof(frame)))
+		return -EFAULT;
+
+	memset(&use, 0, sizeof(use));
+	use.dac_mask = frame.dac_mask;
+	for (i = 0; i < NUM_PORTS; i++)
+		if (frame.port_mask & (1 << i))
+			use.port_mask[i] = 0xFF;
+	if (frame.flags & IDMF_OUT_GPIO)
+		use.gpio_mask = 0xFFFFFFFF;
+
+	err = idmf_claim_check(board, ctx, &use);
+	if (err)
+		return err;
+
+	rtdm_lock_get_irqsave(&out->lock, lock_ctx);
+
+	valid = (frame.flags & IDMF_OUT_FORCE) ? 0 : out->valid;
+
+	for (i = 0; i < NUM_DACS; i++) {
+		if (!(frame.dac_mask & (1 << i)))
+			continue;
+
+		if ((valid & IDMF_OUT_VALID_DAC(i)) && out->dac[i] == frame.dac[i])
+			continue;
+
+		idmf_reg_write(board, DAC_VALUE + i * 0x04, (u32)frame.dac[i]);
+		out->dac[i] = frame.dac[i];
+		out->valid |= IDMF_OUT_VALID_DAC(i);
+		latch = 1;
+	}
+
+	if (latch)
+		idmf_reg_write(board, DAC_CONF, IDMF_DAC_LATCH);
+
+	for (i = 0; i < NUM_PORTS; i++) {
+		if (!(frame.port_mask & (1 << i)))
+			continue;
+
+		if ((valid & IDMF_OUT_VALID_PORT(i)) && out->port[i] == frame.port[i])
+			continue;
+
+		idmf_reg_write(board, PRT_VALUE + i * 0x04, frame.port[i]);
+		out->port[i] = frame.port[i];
+		out->valid |= IDMF_OUT_VALID_PORT(i);
+	}
+
+	if ((frame.flags & IDMF_OUT_GPIO) && !((valid & IDMF_OUT_VALID_GPIO)
+			&& out->gpio == frame.gpio)) {
+		idmf_reg_write(board, GPIO_OUT, frame.gpio);
+		out->gpio = frame.gpio;
+		out->valid |= IDMF_OUT_VALID_GPIO;
+	}
+
+	if ((frame.flags & IDMF_OUT_LED) && !((valid & IDMF_OUT_VALID_LED)
+			&& out->led == frame.led)) {
+		idmf_reg_write(board, BCT_LED, frame.led);
+		out->led = frame.led;
+		out->valid |= IDMF_OUT_VALID_LED;
+	}
+
+	rtdm_lock_put_irqrestore(&out->lock, lock_ctx);
+
+	return 0;
+}
+
+/**
+ * idmf_bit_op - set, clear and toggle bits of an output register
+ * @board:	the board
+ * @arg:	user pointer to struct idmf_bit_op
+ *
+ * The read-modify-write runs on the output shadow under the output lock,
+ * unchanged values are not written. Stores through the register window
+ * mapped into user space are not seen by the shadow, so the register is read
+ * back and always written while the window is mapped.
+ */
+static int idmf_bit_op(struct idmf_board *board, struct idmf_ctx *ctx,
+		void __user *arg)
+{
+	struct idmf_out *out = &board->out;
+	struct idmf_bit_op op;
+	struct idmf_claim use;
+	rtdm_lockctx_t lock_ctx;
+	u32 offset, bit, mask;
+	u32 value, prev;
+	int known;
+	int err;
+
+	if (copy_from_user(&op, arg, sizeof(op)))
+		return -EFAULT;
+
+	memset(&use, 0, sizeof(use));
+
+	if (op.target < NUM_PORTS) {
+		offset = PRT_VALUE + op.target * 0x04;
+		bit = IDMF_OUT_VALID_PORT(op.target);
+		mask = 0xFF;
+		use.port_mask[op.target] = (u8)(op.set | op.clear | op.toggle);
+	} else if (op.target == IDMF_BITS_GPIO) {
+		offset = GPIO_OUT;
+		bit = IDMF_OUT_VALID_GPIO;
+		mask = 0xFFFFFFFF;
+		use.gpio_mask = op.set | op.clear | op.toggle;
+	} else
+		return -EINVAL;
+
+	/* only the changed bits have to be owned */
+	err = idmf_claim_check(board, ctx, &use);
+	if (err)
+		return err;
+
+	rtdm_lock_get_irqsave(&out->lock, lock_ctx);
+
+	known = (out->valid & bit) && !atomic_read(&board->map_count);
+
+	if (known)
+		prev = op.target < NUM_PORTS ? out->port[op.target] : out->gpio;
+	else
+		prev = idmf_reg_read(board, offset) & mask;
+
+	value = (((prev | op.set) & ~op.clear) ^ op.toggle) & mask;
+
+	if (!known || value != prev)
+		idmf_reg_write(board, offset, value);
+
+	if (op.target < NUM_PORTS)
+		out->port[op.target] = (u8)value;
+	else
+		out->gpio = value;
+	out->valid |= bit;
+
+	rtdm_lock_put_irqrestore(&out->lock, lock_ctx);
+
+	op.value = value;
+
+	if (copy_to_user(arg, &op, sizeof(op)))
+		return -EFAULT;
+
+	return 0;
+}
+
+/* removes a program from @ctx and frees it once no execution uses it */
+static int idmf_prog_remove(struct idmf_ctx *ctx, u32 index)
+{
+	struct idmf_prog *prog;
+	rtdm_lockctx_t lock_ctx;
+
+	rtdm_lock_get_irqsave(&ctx->prog_lock, lock_ctx);
+	prog = ctx->prog[index];
+	ctx->prog[index] = NULL;
+	rtdm_lock_put_irqrestore(&ctx->prog_lock, lock_ctx);
+
+	if (!prog)
+		return -EINVAL;
+
+	while (atomic_read(&prog->users))
+		msleep(1);
+
+	kfree(prog);
+
+	return 0;
+}
+
+/**
+ * idmf_prog_load - validate and store a register program
+ * @board:	the board
+ * @ctx:	the open file owning the program
+ * @arg:	user pointer to struct idmf_prog_load
+ *
+ * Offsets, slots and the total delay are checked once here, so executions
+ * of the program do not decode or check single operations.
+ */
+static int idmf_prog_load(struct idmf_board *board, struct idmf_ctx *ctx,
+		void __user *arg)
+{
+	struct idmf_prog_load req;
+	struct idmf_prog *prog;
+	struct idmf_prog_op *op;
+	rtdm_lockctx_t lock_ctx;
+	u32 delay = 0;
+	u32 i;
+	int err;
+
+	/* programs can only be allocated from non-realtime context */
+	if (rtdm_in_rt_context())
+		return -ENOSYS;
+
+	if (copy_from_user(&req, arg, sizeof(req)))
+		return -EFAULT;
+
+	if (!req.count || req.count > IDMF_PROG_MAX_OPS)
+		return -EINVAL;
+
+	prog = kzalloc(sizeof(*prog) + req.count * sizeof(prog->ops[0]),
+			GFP_KERNEL);
+	if (!prog)
+		return -ENOMEM;
+
+	if (copy_from_user(prog->ops, (void __user *)(unsigned long)req.ops,
+			req.count * sizeof(prog->ops[0]))) {
+		err = -EFAULT;
+		goto leave;
+	}
+
+	prog->count = req.count;
+
+	err = -EINVAL;
+
+	for (i = 0; i < prog->count; i++) {
+		op = &prog->ops[i];
+
+		if (op->slot >= IDMF_PROG_SLOTS)
+			goto leave;
+
+		if (op->op != IDMF_PROG_DELAY && !idmf_reg_valid(op->offset))
+			goto leave;
+
+		switch (op->op) {
+		case IDMF_PROG_READ:
+			break;
+		case IDMF_PROG_READ_OUT:
+			prog->out_slots = max_t(u32, prog->out_slots, op->slot + 1);
+			break;
+		case IDMF_PROG_WRITE_IN:
+			prog->in_slots = max_t(u32, prog->in_slots, op->slot + 1);
+			/* fall through */
+		case IDMF_PROG_WRITE:
+			idmf_claim_reg(&prog->use, op->offset);
+			break;
+		case IDMF_PROG_DELAY:
+			if (op->value > IDMF_PROG_MAX_DELAY - delay)
+				goto leave;
+			delay += op->value;
+			break;
+		default:
+			goto leave;
+		}
+	}
+
+	rtdm_lock_get_irqsave(&ctx->prog_lock, lock_ctx);
+	for (i = 0; i < IDMF_PROG_MAX; i++)
+		if (!ctx->prog[i])
+			break;
+	if (i < IDMF_PROG_MAX)
+		ctx->prog[i] = prog;
+	rtdm_lock_put_irqrestore(&ctx->prog_lock, lock_ctx);
+
+	if (i == IDMF_PROG_MAX) {
+		err = -ENOSPC;
+		goto leave;
+	}
+
+	/* handles start at 1 */
+	req.handle = i + 1;
+
+	if (copy_to_user(arg, &req, sizeof(req))) {
+		idmf_prog_remove(ctx, i);
+		return -EFAULT;
+	}
+
+	return 0;
+
+	leave:
+	kfree(prog);
+	return err;
+}
+
+static int idmf_prog_unload(struct idmf_ctx *ctx, void __user *arg)
+{
+	u32 handle;
+
+	if (rtdm_in_rt_context())
+		return -ENOSYS;
+
+	if (get_user(handle, (u32 __user *)arg))
+		return -EFAULT;
+
+	if (!handle || handle > IDMF_PROG_MAX)
+		return -EINVAL;
+
+	return idmf_prog_remove(ctx, handle - 1);
+}
+
+/**
+ * idmf_prog_run - execute a register program
+ * @board:	the board
+ * @ctx:	the open file owning the program
+ * @arg:	user pointer to struct idmf_prog_run
+ *
+ * The operations run back to back like a transaction, without a lock held
+ * across them.
+ */
+static int idmf_prog_run(struct idmf_board *board, struct idmf_ctx *ctx,
+		void __user *arg)
+{
+	struct idmf_prog_run __user *run = arg;
+	const struct idmf_prog_op *op, *end;
+	struct idmf_prog *prog;
+	rtdm_lockctx_t lock_ctx;
+	u32 in[IDMF_PROG_SLOTS];
+	u32 out[IDMF_PROG_SLOTS];
+	u64 timestamp;
+	u32 handle;
+	int err;
+
+	if (get_user(handle, &run->handle))
+		return -EFAULT;
+
+	if (!handle || handle > IDMF_PROG_MAX)
+		return -EINVAL;
+
+	rtdm_lock_get_irqsave(&ctx->prog_lock, lock_ctx);
+	prog = ctx->prog[handle - 1];
+	if (prog)
+		atomic_inc(&prog->users);
+	rtdm_lock_put_irqrestore(&ctx->prog_lock, lock_ctx);
+
+	if (!prog)
+		return -EINVAL;
+
+	err = idmf_claim_check(board, ctx, &prog->use);
+	if (err)
+		goto leave;
+
+	if (copy_from_user(in, run->in, prog->in_slots * sizeof(in[0]))) {
+		err = -EFAULT;
+		goto leave;
+	}
+
+	memset(out, 0, prog->out_slots * sizeof(out[0]));
+
+	timestamp = rtdm_clock_read();
+
+	end = prog->ops + prog->count;
+	for (op = prog->ops; op < end; op++) {
+		switch (op->op) {
+		case IDMF_PROG_READ:
+			idmf_reg_read(board, op->offset);
+			break;
+		case IDMF_PROG_READ_OUT:
+			out[op->slot] = idmf_reg_read(board, op->offset);
+			break;
+		case IDMF_PROG_WRITE:
+			idmf_reg_write_bypass(board, op->offset, op->value);
+			break;
+		case IDMF_PROG_WRITE_IN:
+			idmf_reg_write_bypass(board, op->offset, in[op->slot]);
+			break;
+		case IDMF_PROG_DELAY:
+			rtdm_task_busy_sleep(op->value);
+			break;
+		}
+	}
+
+	if (put_user(timestamp, &run->timestamp) ||
+			copy_to_user(run->out, out, prog->out_slots * sizeof(out[0])))
+		err = -EFAULT;
+
+	leave:
+	atomic_dec(&prog->users);
+	return err;
+}
+
+static inline u32 idmf_acq_available(struct idmf_acq *acq)
+{
+	return ACCESS_ONCE(acq->shm->head) - ACCESS_ONCE(acq->shm->tail);
+}
+
+/* keeps the ring from being reallocated, fails while it is */
+static inline int idmf_acq_get(struct idmf_acq *acq)
+{
+	return atomic_add_unless(&acq->users, 1, -1) ? 0 : -EBUSY;
+}
+
+static inline void idmf_acq_put(struct idmf_acq *acq)
+{
+	smp_mb__before_atomic_dec();
+	atomic_dec(&acq->users);
+}
+
+static void idmf_acq_task(void *arg)
+{
+	struct idmf_board *board = arg;
+	struct idmf_acq *acq = &board->acq;
+	struct idmf_sample *sample;
+	u32 head;
+	int err;
+
+	while (!ACCESS_ONCE(acq->stop)) {
+		err = rtdm_task_wait_period();
+		/* missed periods are not made up for */
+		if (err && err != -ETIMEDOUT)
+			break;
+
+		head = acq->shm->head;
+
+		if (head - ACCESS_ONCE(acq->shm->tail) >= acq->frames) {
+			acq->shm->overruns++;
+			continue;
+		}
+
+		/* the consumer is done with the slot before it is reused */
+		smp_mb();
+
+		/* the sample is written in place and published afterwards */
+		sample = &acq->ring[head & (acq->frames - 1)];
+		sample->seq = (u32)acq->samples++;
+		idmf_capture(board, &acq->config, sample);
+
+		idmf_stats_record(board, IDMF_STAT_ACQ,
+				rtdm_clock_read() - sample->timestamp);
+
+		smp_wmb();
+		ACCESS_ONCE(acq->shm->head) = head + 1;
+
+		rtdm_event_signal(&acq->ready);
+
+		smp_mb();
+		if (atomic_read(&acq->nrt_waiters))
+			rtdm_nrtsig_pend(&acq->nrt_ready);
+	}
+}
+
+static void idmf_acq_nrt_ready(rtdm_nrtsig_t nrt_sig, void *arg)
+{
+	struct idmf_acq *acq = arg;
+
+	wake_up_interruptible(&acq->nrt_wait);
+}
+
+static int idmf_acq_init(struct idmf_board *board)
+{
+	struct idmf_acq *acq = &board->acq;
+	int err;
+
+	err = rtdm_nrtsig_init(&acq->nrt_ready, idmf_acq_nrt_ready, acq);
+	if (err)
+		return err;
+
+	rtdm_event_init(&acq->ready, 0);
+	init_waitqueue_head(&acq->nrt_wait);
+	atomic_set(&acq->nrt_waiters, 0);
+	atomic_set(&acq->map_count, 0);
+	atomic_set(&acq->reader, 0);
+	atomic_set(&acq->users, 0);
+	mutex_init(&acq->lock);
+
+	return 0;
+}
+
+/* called with acq->lock held */
+static void idmf_acq_halt(struct idmf_board *board)
+{
+	struct idmf_acq *acq = &board->acq;
+
+	if (!acq->running)
+		return;
+
+	ACCESS_ONCE(acq->stop) = 1;
+	rtdm_task_join_nrt(&acq->task, 100);
+	acq->running = 0;
+
+	/* let blocked readers notice the end of the acquisition */
+	rtdm_event_signal(&acq->ready);
+	wake_up_interruptible(&acq->nrt_wait);
+}
+
+static void idmf_acq_cleanup(struct idmf_board *board)
+{
+	struct idmf_acq *acq = &board->acq;
+
+	mutex_lock(&acq->lock);
+	idmf_acq_halt(board);
+	mutex_unlock(&acq->lock);
+
+	rtdm_event_destroy(&acq->ready);
+	rtdm_nrtsig_destroy(&acq->nrt_ready);
+
+	/* the ring may still be mapped, idmf_board_put frees it */
+}
+
+/**
+ * idmf_acq_start - start the periodic acquisition
+ * @board:	the board
+ * @arg:	user pointer to struct idmf_acq_config
+ *
+ * The ring is allocated here, the acquisition task does not allocate.
+ * Samples left over from a previous run are discarded.
+ */
+static int idmf_acq_start(struct idmf_board *board, void __user *arg)
+{
+	struct idmf_acq *acq = &board->acq;
+	struct idmf_acq_config config;
+	rtdm_lockctx_t lock_ctx;
+	int resizing = 0;
+	int err = 0;
+
+	/* the task and the ring can only be set up from non-realtime context */
+	if (rtdm_in_rt_context())
+		return -ENOSYS;
+
+	if (copy_from_user(&config, arg, sizeof(config)))
+		return -EFAULT;
+
+	if (config.period_ns < IDMF_ACQ_MIN_PERIOD)
+		return -EINVAL;
+
+	if (config.frames < 2 || config.frames > IDMF_ACQ_MAX_FRAMES
+			|| (config.frames & (config.frames - 1)))
+		return -EINVAL;
+
+	/* the conversions of a period have to fit into the period */
+	if (config.oversample > IDMF_ACQ_MAX_OVERSAMPLE
+			|| (u64)max(config.oversample, 1U)
+			* (IDMF_ADC_REQUEST_NS + IDMF_ADC_CONVERT_NS)
+			>= config.period_ns)
+		return -EINVAL;
+
+	if (!config.priority)
+		config.priority = IDMF_ACQ_PRIORITY;
+
+	if (config.priority < RTDM_TASK_LOWEST_PRIORITY
+			|| config.priority > RTDM_TASK_HIGHEST_PRIORITY)
+		return -EINVAL;
+
+	mutex_lock(&acq->lock);
+
+	if (acq->running) {
+		err = -EBUSY;
+		goto unlock;
+	}
+
+	if (acq->area && acq->frames != config.frames) {
+		/*
+		 * a mapped ring can not be resized, a reader or waiter woken
+		 * by the last stop may still be using it
+		 */
+		if (atomic_read(&acq->map_count)
+				|| atomic_cmpxchg(&acq->users, 0, -1)) {
+			err = -EBUSY;
+			goto unlock;
+		}
+		resizing = 1;
+
+		vfree(acq->area);
+		acq->area = NULL;
+		acq->shm = NULL;
+		acq->ring = NULL;
+	}
+
+	if (!acq->area) {
+		acq->area_size = PAGE_ALIGN(PAGE_SIZE
+				+ config.frames * sizeof(struct idmf_sample));
+		acq->area = vmalloc(acq->area_size);
+		if (!acq->area) {
+			err = -ENOMEM;
+			goto unlock;
+		}
+		memset(acq->area, 0, acq->area_size);
+
+		acq->shm = acq->area;
+		acq->ring = (struct idmf_sample *)((u8 *)acq->area + PAGE_SIZE);
+		acq->frames = config.frames;
+
+		acq->shm->frames = config.frames;
+		acq->shm->frame_size = sizeof(struct idmf_sample);
+		acq->shm->data_offset = PAGE_SIZE;
+	}
+
+	acq->config = config;
+	acq->shm->head = 0;
+	acq->shm->tail = 0;
+	acq->shm->overruns = 0;
+	acq->samples = 0;
+	acq->stop = 0;
+	rtdm_event_clear(&acq->ready);
+
+	rtdm_lock_get_irqsave(&board->accum.lock, lock_ctx);
+	idmf_accum_reset(&board->accum);
+	rtdm_lock_put_irqrestore(&board->accum.lock, lock_ctx);
+
+	err = rtdm_task_init(&acq->task, board->dev->device_name, idmf_acq_task,
+			board, config.priority, config.period_ns);
+	if (err) {
+		rtdm_printk("idmf_drv: %s: rtdm_task_init failed\n",
+				__PRETTY_FUNCTION__);
+		goto unlock;
+	}
+
+	acq->running = 1;
+
+	unlock:
+	if (resizing)
+		atomic_set(&acq->users, 0);
+
+	mutex_unlock(&acq->lock);
+
+	return err;
+}
+
+static int idmf_acq_stop(struct idmf_board *board)
+{
+	struct idmf_acq *acq = &board->acq;
+
+	if (rtdm_in_rt_context())
+		return -ENOSYS;
+
+	mutex_lock(&acq->lock);
+	idmf_acq_halt(board);
+	mutex_unlock(&acq->lock);
+
+	return 0;
+}
+
+static int idmf_acq_status(struct idmf_board *board, void __user *arg)
+{
+	struct idmf_acq *acq = &board->acq;
+	struct idmf_acq_status status;
+
+	/* the state is taken consistently with start and stop */
+	if (rtdm_in_rt_context())
+		return -ENOSYS;
+
+	mutex_lock(&acq->lock);
+	status.running = acq->running;
+	status.frames = acq->frames;
+	status.available = acq->ring ? idmf_acq_available(acq) : 0;
+	status.overruns = acq->ring ? acq->shm->overruns : 0;
+	status.samples = acq->samples;
+	mutex_unlock(&acq->lock);
+
+	if (copy_to_user(arg, &status, sizeof(status)))
+		return -EFAULT;
+
+	return 0;
+}
+
+/*
+ * A user space mapping holds a reference to the board and to the module, so
+ * its vm_ops stay valid and rmmod fails instead of waiting for it.
+ */
+static void idmf_board_get(struct idmf_board *board)
+{
+	__module_get(THIS_MODULE);
+	atomic_inc(&board->refs);
+}
+
+/**
+ * idmf_board_put - drop a reference to a board
+ * @board:	the board
+ *
+ * The PCI device holds one reference and every user space mapping of the
+ * register window or the sample ring another one. The sample ring and the
+ * PCI resources the mappings refer to are released with the last reference,
+ * so removing the device does not have to wait for user space.
+ */
+static void idmf_board_put(struct idmf_board *board)
+{
+	struct pci_dev *pdev = board->pdev;
+
+	if (!atomic_dec_and_test(&board->refs))
+		return;
+
+	vfree(board->acq.area);
+
+	if (board->init_flags & INIT_PCI_IOMAP)
+		pci_iounmap(pdev, board->base);
+
+	if (board->init_flags & INIT_PCI_REQUEST_REGIONS)
+		pci_release_regions(pdev);
+
+	if (board->init_flags & INIT_PCI_ENABLE)
+		pci_disable_device(pdev);
+
+	pci_dev_put(pdev);
+
+	kfree(board);
+}
+
+/* drops the reference of a mapping taken by idmf_board_get */
+static void idmf_board_unmap(struct idmf_board *board)
+{
+	idmf_board_put(board);
+	module_put(THIS_MODULE);
+}
+
+static void idmf_acq_vm_open(struct vm_area_struct *vma)
+{
+	struct idmf_board *board = vma->vm_private_data;
+
+	atomic_inc(&board->acq.map_count);
+	idmf_board_get(board);
+}
+
+static void idmf_acq_vm_close(struct vm_area_struct *vma)
+{
+	struct idmf_board *board = vma->vm_private_data;
+
+	atomic_dec(&board->acq.map_count);
+	idmf_board_unmap(board);
+}
+
+static struct vm_operations_struct idmf_acq_vm_ops = {
+	.open = idmf_acq_vm_open,
+	.close = idmf_acq_vm_close,
+};
+
+/**
+ * idmf_acq_mmap - map the sample ring into the caller's address space
+ * @board:	the board
+ * @user_info:	the calling process
+ * @arg:	user pointer to struct idmf_mmap
+ *
+ * The mapping starts with struct idmf_ring. The ring has to be allocated by
+ * starting the acquisition first; it keeps its size while it is mapped.
+ */
+static int idmf_acq_mmap(struct idmf_board *board,
+		rtdm_user_info_t *user_info, void __user *arg)
+{
+	struct idmf_acq *acq = &board->acq;
+	struct idmf_mmap map;
+	void *ptr;
+	int err;
+
+	if (rtdm_in_rt_context())
+		return -ENOSYS;
+
+	if (!user_info)
+		return -EPERM;
+
+	mutex_lock(&acq->lock);
+
+	if (!acq->area) {
+		err = -ENODEV;
+		goto unlock;
+	}
+
+	err = rtdm_mmap_to_user(user_info, acq->area, acq->area_size,
+			PROT_READ | PROT_WRITE, &ptr, &idmf_acq_vm_ops, board);
+	if (err) {
+		rtdm_printk("idmf_drv: %s: rtdm_mmap_to_user failed\n",
+				__PRETTY_FUNCTION__);
+		goto unlock;
+	}
+
+	/* vm_ops->open is not called for the initial mapping */
+	atomic_inc(&acq->map_count);
+	idmf_board_get(board);
+
+	map.addr = (unsigned long)ptr;
+	map.size = acq->area_size;
+
+	if (copy_to_user(arg, &map, sizeof(map))) {
+		rtdm_munmap(user_info, ptr, map.size);
+		err = -EFAULT;
+	}
+
+	unlock:
+	mutex_unlock(&acq->lock);
+
+	return err;
+}
+
+/* waits until @count samples are available, the acquisition ends or the
+ * timeout expires */
+static int idmf_acq_wait(struct idmf_acq *acq, u32 count)
+{
+	rtdm_toseq_t timeout_seq;
+	nanosecs_rel_t timeout = acq->config.timeout;
+	long ret;
+
+	if (rtdm_in_rt_context()) {
+		rtdm_toseq_init(&timeout_seq, timeout);
+
+		while (idmf_acq_available(acq) < count && acq->running) {
+			ret = rtdm_event_timedwait(&acq->ready, timeout, &timeout_seq);
+			if (ret)
+				return ret;
+		}
+
+		return 0;
+	}
+
+	if (timeout < 0)
+		return idmf_acq_available(acq) < count ? -EWOULDBLOCK : 0;
+
+	atomic_inc(&acq->nrt_waiters);
+	smp_mb();
+
+	if (timeout == 0) {
+		ret = wait_event_interruptible(acq->nrt_wait,
+				idmf_acq_available(acq) >= count || !acq->running);
+	} else {
+		ret = wait_event_interruptible_timeout(acq->nrt_wait,
+				idmf_acq_available(acq) >= count || !acq->running,
+				msecs_to_jiffies(div_u64(timeout + 999999, 1000000)));
+		ret = ret > 0 ? 0 : (ret ? ret : -ETIMEDOUT);
+	}
+
+	atomic_dec(&acq->nrt_waiters);
+
+	return ret;
+}
+
+static int idmf_acq_wait_user(struct idmf_board *board, void __user *arg)
+{
+	struct idmf_acq *acq = &board->acq;
+	u32 count;
+	int err;
+
+	if (copy_from_user(&count, arg, sizeof(count)))
+		return -EFAULT;
+
+	err = idmf_acq_get(acq);
+	if (err)
+		return err;
+
+	if (!acq->ring)
+		err = -ENODEV;
+	else if (!count || count > acq->frames)
+		err = -EINVAL;
+	else
+		err = idmf_acq_wait(acq, count);
+
+	idmf_acq_put(acq);
+
+	return err;
+}
+
+/**
+ * idmf_read - read samples of the periodic acquisition
+ *
+ * The call blocks until as many samples as fit into the buffer are
+ * available, see struct idmf_acq_config for the timeout. When the timeout
+ * expires or the acquisition stops, the available samples are returned.
+ * Samples are consumed by a single reader at a time, a concurrent read fails
+ * with -EBUSY. The reader keeps the ring from being reallocated by a restart
+ * of the acquisition until it has copied the samples.
+ */
+static ssize_t idmf_read_samples(struct idmf_board *board, void *buf,
+		size_t nbyte)
+{
+	struct idmf_acq *acq = &board->acq;
+	struct idmf_sample __user *samples = buf;
+	u32 count, first, tail;
+	ssize_t ret;
+	int err;
+
+	if (atomic_cmpxchg(&acq->reader, 0, 1))
+		return -EBUSY;
+
+	ret = idmf_acq_get(acq);
+	if (ret) {
+		atomic_set(&acq->reader, 0);
+		return ret;
+	}
+
+	if (!acq->ring) {
+		ret = -ENODEV;
+		goto out;
+	}
+
+	count = min_t(size_t, nbyte / sizeof(struct idmf_sample), acq->frames);
+	if (!count) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	err = idmf_acq_wait(acq, count);
+
+	count = min(count, idmf_acq_available(acq));
+	if (!count) {
+		ret = err ? err : 0;
+		goto out;
+	}
+
+	smp_rmb();
+
+	tail = acq->shm->tail;
+	first = min(count, acq->frames - (tail & (acq->frames - 1)));
+
+	if (copy_to_user(samples, &acq->ring[tail & (acq->frames - 1)],
+			first * sizeof(struct idmf_sample))) {
+		ret = -EFAULT;
+		goto out;
+	}
+
+	if (count > first && copy_to_user(samples + first, acq->ring,
+			(count - first) * sizeof(struct idmf_sample))) {
+		ret = -EFAULT;
+		goto out;
+	}
+
+	/* the slots may be overwritten once the tail has moved */
+	smp_mb();
+	ACCESS_ONCE(acq->shm->tail) = tail + count;
+
+	ret = count * sizeof(struct idmf_sample);
+
+	out:
+	idmf_acq_put(acq);
+	smp_mb();
+	atomic_set(&acq->reader, 0);
+
+	return ret;
+}
+
+ssize_t idmf_read(struct rtdm_dev_context *context,
+		rtdm_user_info_t *user_info, void *buf, size_t nbyte)
+{
+	struct idmf_board *board;
+	nanosecs_abs_t start;
+	ssize_t ret;
+
+	board = (struct idmf_board *)(context->device->device_data);
+
+	start = rtdm_clock_read();
+
+	ret = idmf_read_samples(board, buf, nbyte);
+	if (ret == -EFAULT)
+		board->stats.copy_errors++;
+
+	idmf_stats_record(board, IDMF_STAT_READ, rtdm_clock_read() - start);
+
+	return ret;
+}
+
+/* returns 1 when an event was queued, called with mon->sample_lock held */
+static int idmf_mon_push(struct idmf_mon *mon, nanosecs_abs_t timestamp,
+		u32 source, u32 value, u32 prev, u32 mask)
+{
+	struct idmf_mon_event *event;
+	u32 changed = (value ^ prev) & mask;
+
+	if (!changed)
+		return 0;
+
+	if (mon->head - ACCESS_ONCE(mon->tail) >= IDMF_MON_EVENTS) {
+		mon->lost++;
+		return 0;
+	}
+
+	/* the reader is done with the slot before it is reused */
+	smp_mb();
+
+	event = &mon->ring[mon->head & (IDMF_MON_EVENTS - 1)];
+	event->timestamp = timestamp;
+	event->source = source;
+	event->value = value;
+	event->rising = changed & value;
+	event->falling = changed & ~value;
+
+	smp_wmb();
+	ACCESS_ONCE(mon->head) = mon->head + 1;
+
+	return 1;
+}
+
+/**
+ * idmf_mon_sample - sample the monitored inputs and queue their edges
+ * @board:	the board
+ *
+ * Called by the monitor task and by the interrupt handler.
+ */
+static void idmf_mon_sample(struct idmf_board *board)
+{
+	struct idmf_mon *mon = &board->mon;
+	rtdm_lockctx_t lock_ctx;
+	nanosecs_abs_t timestamp;
+	u32 mask;
+	u32 gpio = 0;
+	u8 port[NUM_PORTS];
+	int queued = 0;
+	int i;
+
+	rtdm_lock_get_irqsave(&mon->sample_lock, lock_ctx);
+
+	if (!mon->active) {
+		rtdm_lock_put_irqrestore(&mon->sample_lock, lock_ctx);
+		return;
+	}
+
+	timestamp = rtdm_clock_read();
+
+	if (mon->config.gpio_mask)
+		gpio = idmf_reg_read(board, GPIO_IN);
+
+	for (i = 0; i < NUM_PORTS; i++) {
+		mask = (mon->config.port_mask >> (i * 8)) & 0xFF;
+		port[i] = mask ? (u8)idmf_reg_read(board, PRT_VALUE + i * 0x04) : 0;
+	}
+
+	/* the first sample only sets the reference */
+	if (mon->primed) {
+		queued |= idmf_mon_push(mon, timestamp, IDMF_MON_GPIO, gpio,
+				mon->gpio, mon->config.gpio_mask);
+
+		for (i = 0; i < NUM_PORTS; i++)
+			queued |= idmf_mon_push(mon, timestamp, IDMF_MON_PORT(i),
+					port[i], mon->port[i],
+					(mon->config.port_mask >> (i * 8)) & 0xFF);
+	}
+
+	mon->primed = 1;
+	mon->gpio = gpio;
+	memcpy(mon->port, port, sizeof(port));
+
+	rtdm_lock_put_irqrestore(&mon->sample_lock, lock_ctx);
+
+	if (!queued)
+		return;
+
+	rtdm_event_signal(&mon->ready);
+
+	smp_mb();
+	if (atomic_read(&mon->nrt_waiters))
+		rtdm_nrtsig_pend(&mon->nrt_ready);
+}
+
+static void idmf_mon_task(void *arg)
+{
+	struct idmf_board *board = arg;
+	struct idmf_mon *mon = &board->mon;
+	int err;
+
+	while (!ACCESS_ONCE(mon->stop)) {
+		err = rtdm_task_wait_period();
+		/* missed periods are not made up for */
+		if (err && err != -ETIMEDOUT)
+			break;
+
+		idmf_mon_sample(board);
+	}
+}
+
+static void idmf_mon_nrt_ready(rtdm_nrtsig_t nrt_sig, void *arg)
+{
+	struct idmf_mon *mon = arg;
+
+	wake_up_interruptible(&mon->nrt_wait);
+}
+
+static int idmf_mon_init(struct idmf_board *board)
+{
+	struct idmf_mon *mon = &board->mon;
+	int err;
+
+	err = rtdm_nrtsig_init(&mon->nrt_ready, idmf_mon_nrt_ready, mon);
+	if (err)
+		return err;
+
+	rtdm_event_init(&mon->ready, 0);
+	rtdm_lock_init(&mon->sample_lock);
+	init_waitqueue_head(&mon->nrt_wait);
+	atomic_set(&mon->nrt_waiters, 0);
+	atomic_set(&mon->reader, 0);
+	mutex_init(&mon->lock);
+
+	return 0;
+}
+
+/* called with mon->lock held */
+static void idmf_mon_halt(struct idmf_board *board)
+{
+	struct idmf_mon *mon = &board->mon;
+	rtdm_lockctx_t lock_ctx;
+
+	rtdm_lock_get_irqsave(&mon->sample_lock, lock_ctx);
+	mon->active = 0;
+	rtdm_lock_put_irqrestore(&mon->sample_lock, lock_ctx);
+
+	if (mon->running) {
+		ACCESS_ONCE(mon->stop) = 1;
+		rtdm_task_join_nrt(&mon->task, 100);
+		mon->running = 0;
+	}
+
+	/* let blocked readers notice the end of the monitor */
+	rtdm_event_signal(&mon->ready);
+	wake_up_interruptible(&mon->nrt_wait);
+}
+
+static void idmf_mon_cleanup(struct idmf_board *board)
+{
+	struct idmf_mon *mon = &board->mon;
+
+	mutex_lock(&mon->lock);
+	idmf_mon_halt(board);
+	mutex_unlock(&mon->lock);
+
+	rtdm_event_destroy(&mon->ready);
+	rtdm_nrtsig_destroy(&mon->nrt_ready);
+
+	vfree(mon->ring);
+	mon->ring = NULL;
+}
+
+/**
+ * idmf_mon_start - start the edge monitor
+ * @board:	the board
+ * @arg:	user pointer to struct idmf_mon_config
+ *
+ * Events left over from a previous run are discarded.
+ */
+static int idmf_mon_start(struct idmf_board *board, void __user *arg)
+{
+	struct idmf_mon *mon = &board->mon;
+	struct idmf_mon_config config;
+	rtdm_lockctx_t lock_ctx;
+	int err = 0;
 
-#define REG_WRITE	0x10000000
-#define REG_READ	0x20000000
+	/* the task and the queue can only be set up from non-realtime context */
+	if (rtdm_in_rt_context())
+		return -ENOSYS;
 
-int idmf_open(struct rtdm_dev_context *context, rtdm_user_info_t * user_info,
-		int oflags);
+	if (copy_from_user(&config, arg, sizeof(config)))
+		return -EFAULT;
 
-int idmf_close(struct rtdm_dev_context *context, rtdm_user_info_t * user_info);
+	if (!config.gpio_mask && !(config.port_mask & 0x00FFFFFF))
+		return -EINVAL;
 
-int idmf_ioctl(struct rtdm_dev_context *context, rtdm_user_info_t *user_info,
-		unsigned int request, void __user *arg);
+	if ((config.flags & IDMF_MON_IRQ)
+			&& !(board->init_flags & INIT_PCI_REQUEST_IRQ))
+		return -ENODEV;
 
-static void idmf_pci_remove(struct pci_dev *pdev);
+	if (config.period_ns ? config.period_ns < IDMF_MON_MIN_PERIOD
+			: !(config.flags & IDMF_MON_IRQ))
+		return -EINVAL;
 
-static int idmf_pci_probe(struct pci_dev *pdev, const struct pci_device_id *id);
+	if (!config.priority)
+		config.priority = IDMF_ACQ_PRIORITY;
 
-//static long idmf_ioctl(struct rtdm_dev_context *context, rtdm_user_info_t *user_info,
-//		unsigned int request, void *arg)
-int idmf_ioctl(struct rtdm_dev_context *context, rtdm_user_info_t *user_info,
+	if (config.priority < RTDM_TASK_LOWEST_PRIORITY
+			|| config.priority > RTDM_TASK_HIGHEST_PRIORITY)
+		return -EINVAL;
+
+	mutex_lock(&mon->lock);
+
+	if (mon->active) {
+		err = -EBUSY;
+		goto unlock;
+	}
+
+	if (!mon->ring) {
+		mon->ring = vmalloc(IDMF_MON_EVENTS * sizeof(*mon->ring));
+		if (!mon->ring) {
+			err = -ENOMEM;
+			goto unlock;
+		}
+	}
+
+	mon->config = config;
+	mon->head = 0;
+	mon->tail = 0;
+	mon->lost = 0;
+	mon->primed = 0;
+	mon->stop = 0;
+	rtdm_event_clear(&mon->ready);
+
+	rtdm_lock_get_irqsave(&mon->sample_lock, lock_ctx);
+	mon->active = 1;
+	rtdm_lock_put_irqrestore(&mon->sample_lock, lock_ctx);
+
+	if (config.period_ns) {
+		err = rtdm_task_init(&mon->task, board->dev->device_name,
+				idmf_mon_task, board, config.priority, config.period_ns);
+		if (err) {
+			rtdm_printk("idmf_drv: %s: rtdm_task_init failed\n",
+					__PRETTY_FUNCTION__);
+			idmf_mon_halt(board);
+			goto unlock;
+		}
+		mon->running = 1;
+	}
+
+	unlock:
+	mutex_unlock(&mon->lock);
+
+	return err;
+}
+
+static int idmf_mon_stop(struct idmf_board *board)
+{
+	struct idmf_mon *mon = &board->mon;
+
+	if (rtdm_in_rt_context())
+		return -ENOSYS;
+
+	mutex_lock(&mon->lock);
+	idmf_mon_halt(board);
+	mutex_unlock(&mon->lock);
+
+	return 0;
+}
+
+static inline u32 idmf_mon_available(struct idmf_mon *mon)
+{
+	return ACCESS_ONCE(mon->head) - ACCESS_ONCE(mon->tail);
+}
+
+/* waits until an event is queued, the monitor stops or the timeout
+ * expires */
+static int idmf_mon_wait(struct idmf_mon *mon, nanosecs_rel_t timeout)
+{
+	rtdm_toseq_t timeout_seq;
+	long ret;
+
+	if (rtdm_in_rt_context()) {
+		rtdm_toseq_init(&timeout_seq, timeout);
+
+		while (!idmf_mon_available(mon) && mon->active) {
+			ret = rtdm_event_timedwait(&mon->ready, timeout, &timeout_seq);
+			if (ret)
+				return ret;
+		}
+
+		return 0;
+	}
+
+	if (timeout < 0)
+		return idmf_mon_available(mon) ? 0 : -EWOULDBLOCK;
+
+	atomic_inc(&mon->nrt_waiters);
+	smp_mb();
+
+	if (timeout == 0) {
+		ret = wait_event_interruptible(mon->nrt_wait,
+				idmf_mon_available(mon) || !mon->active);
+	} else {
+		ret = wait_event_interruptible_timeout(mon->nrt_wait,
+				idmf_mon_available(mon) || !mon->active,
+				msecs_to_jiffies(div_u64(timeout + 999999, 1000000)));
+		ret = ret > 0 ? 0 : (ret ? ret : -ETIMEDOUT);
+	}
+
+	atomic_dec(&mon->nrt_waiters);
+
+	return ret;
+}
+
+/* consumes events, called by the reader holding mon->reader */
+static int idmf_mon_consume(struct idmf_board *board, void __user *arg)
+{
+	struct idmf_mon *mon = &board->mon;
+	struct idmf_mon_event __user *events;
+	struct idmf_mon_read req;
+	rtdm_lockctx_t lock_ctx;
+	u32 count, first, tail;
+	int err;
+
+	if (copy_from_user(&req, arg, sizeof(req)))
+		return -EFAULT;
+
+	if (!mon->ring)
+		return -ENODEV;
+
+	if (!req.count)
+		return -EINVAL;
+
+	events = (struct idmf_mon_event __user *)(unsigned long)req.events;
+
+	err = idmf_mon_wait(mon, req.timeout);
+
+	rtdm_lock_get_irqsave(&mon->sample_lock, lock_ctx);
+	req.lost = mon->lost;
+	mon->lost = 0;
+	rtdm_lock_put_irqrestore(&mon->sample_lock, lock_ctx);
+
+	count = min(req.count, idmf_mon_available(mon));
+	if (!count && err && !req.lost)
+		return err;
+
+	smp_rmb();
+
+	tail = mon->tail;
+	first = min(count, IDMF_MON_EVENTS - (tail & (IDMF_MON_EVENTS - 1)));
+
+	if (copy_to_user(events, &mon->ring[tail & (IDMF_MON_EVENTS - 1)],
+			first * sizeof(struct idmf_mon_event)))
+		return -EFAULT;
+
+	if (count > first && copy_to_user(events + first, mon->ring,
+			(count - first) * sizeof(struct idmf_mon_event)))
+		return -EFAULT;
+
+	/* the slots may be overwritten once the tail has moved */
+	smp_mb();
+	ACCESS_ONCE(mon->tail) = tail + count;
+
+	req.count = count;
+
+	if (copy_to_user(arg, &req, sizeof(req)))
+		return -EFAULT;
+
+	return 0;
+}
+
+/**
+ * idmf_mon_read - read the events of the edge monitor
+ * @board:	the board
+ * @arg:	user pointer to struct idmf_mon_read
+ *
+ * Events are consumed by a single reader at a time, a concurrent read fails
+ * with -EBUSY. When the timeout expires, the request fails unless events
+ * were lost in the meantime.
+ */
+static int idmf_mon_read(struct idmf_board *board, void __user *arg)
+{
+	struct idmf_mon *mon = &board->mon;
+	int err;
+
+	if (atomic_cmpxchg(&mon->reader, 0, 1))
+		return -EBUSY;
+
+	err = idmf_mon_consume(board, arg);
+
+	smp_mb();
+	atomic_set(&mon->reader, 0);
+
+	return err;
+}
+
+/**
+ * idmf_irq_handler - handle the board interrupt
+ *
+ * The status registers of the counters are read to find the interrupt
+ * sources. The event flags found are written back to MFC_CSR to clear them,
+ * the handler does not rely on a read clearing them, so a level-triggered
+ * line is released before the handler returns. The line may be shared, so
+ * the interrupt is only claimed when a source was found.
+ */
+static int idmf_irq_handler(rtdm_irq_t *irq_handle)
+{
+	struct idmf_board *board = rtdm_irq_get_arg(irq_handle, struct idmf_board);
+	nanosecs_abs_t timestamp = rtdm_clock_read();
+	u32 sources = 0;
+	u32 csr;
+	int i;
+
+	for (i = 0; i < NUM_ENCS; i++) {
+		csr = idmf_reg_read(board, MFC_CSR + i * 0x40);
+		if (!(csr & irq_csr_mask))
+			continue;
+
+		/*
+		 * the event flags are cleared by writing ones, the configuration
+		 * bits are written back unchanged
+		 */
+		idmf_reg_write(board, MFC_CSR + i * 0x40, csr);
+		sources |= 1 << i;
+	}
+
+	if (!sources)
+		return RTDM_IRQ_NONE;
+
+	if (board->mon.config.flags & IDMF_MON_IRQ)
+		idmf_mon_sample(board);
+
+	rtdm_lock_get(&board->irq.lock);
+	board->irq.sources |= sources;
+	board->irq.count++;
+	board->irq.timestamp = timestamp;
+	rtdm_lock_put(&board->irq.lock);
+
+	rtdm_event_signal(&board->irq.event);
+
+	return RTDM_IRQ_HANDLED;
+}
+
+/**
+ * idmf_irq_wait - wait for the board interrupt
+ * @board:	the board
+ * @arg:	user pointer to struct idmf_irq_event
+ *
+ * Events which occurred since the last wait are reported immediately
+ * unless IDMF_IRQ_CLEAR is given.
+ */
+static int idmf_irq_wait(struct idmf_board *board, void __user *arg)
+{
+	struct idmf_irq_event event;
+	rtdm_lockctx_t lock_ctx;
+	int err;
+
+	if (!(board->init_flags & INIT_PCI_REQUEST_IRQ))
+		return -ENODEV;
+
+	/* waiting is only possible in realtime context */
+	if (!rtdm_in_rt_context())
+		return -ENOSYS;
+
+	if (copy_from_user(&event, arg, sizeof(event)))
+		return -EFAULT;
+
+	if (event.flags & IDMF_IRQ_CLEAR) {
+		rtdm_lock_get_irqsave(&board->irq.lock, lock_ctx);
+		rtdm_event_clear(&board->irq.event);
+		board->irq.sources = 0;
+		rtdm_lock_put_irqrestore(&board->irq.lock, lock_ctx);
+	}
+
+	err = rtdm_event_timedwait(&board->irq.event, event.timeout, NULL);
+	if (err)
+		return err;
+
+	rtdm_lock_get_irqsave(&board->irq.lock, lock_ctx);
+	event.sources = board->irq.sources;
+	event.count = board->irq.count;
+	event.timestamp = board->irq.timestamp;
+	board->irq.sources = 0;
+	rtdm_lock_put_irqrestore(&board->irq.lock, lock_ctx);
+
+	if (copy_to_user(arg, &event, sizeof(event)))
+		return -EFAULT;
+
+	return 0;
+}
+
+#if LINUX_VERSION_CODE < KERNEL_VERSION(3, 10, 0)
+#define PDE_DATA(inode)		(PDE(inode)->data)
+#endif
+
+static const char *const idmf_stats_names[IDMF_STAT_IOCTL] = {
+	"reg_read", "reg_write", "read", "acq"
+};
+
+static void idmf_stats_show_hist(struct seq_file *seq, const char *name,
+		int nr, const struct idmf_stat_hist *hist)
+{
+	int i;
+
+	if (name)
+		seq_printf(seq, "%-12s", name);
+	else
+		seq_printf(seq, "ioctl 0x%02x  ", nr);
+
+	seq_printf(seq, " %10u %12llu %10llu", hist->count,
+			div64_u64(hist->total, hist->count),
+			(unsigned long long)hist->max);
+
+	/* bucket n counts durations below 2^n ns */
+	for (i = 0; i < IDMF_STAT_BUCKETS; i++)
+		if (hist->bucket[i])
+			seq_printf(seq, " <%llu:%u", 1ULL << i, hist->bucket[i]);
+
+	seq_puts(seq, "\n");
+}
+
+static int idmf_stats_show(struct seq_file *seq, void *v)
+{
+	struct idmf_board *board = seq->private;
+	struct idmf_stats *stats = &board->stats;
+	int i;
+
+	seq_printf(seq, "%-12s %10s %12s %10s %s\n", "request", "count",
+			"avg ns", "max ns", "histogram");
+
+	for (i = 0; i < IDMF_STAT_HISTS; i++) {
+		if (!stats->hist[i].count)
+			continue;
+
+		idmf_stats_show_hist(seq, i < IDMF_STAT_IOCTL ? idmf_stats_names[i]
+				: NULL, i - IDMF_STAT_IOCTL, &stats->hist[i]);
+	}
+
+	seq_printf(seq, "\n%-12s %10s %10s\n", "register", "reads", "writes");
+
+	for (i = 0; i < IDMF_REG_WINDOW / 4; i++) {
+		if (!stats->reads[i] && !stats->writes[i])
+			continue;
+
+		seq_printf(seq, "0x%04x       %10u %10u\n", i << 2, stats->reads[i],
+				stats->writes[i]);
+	}
+
+	seq_printf(seq, "\ncopy errors  %10u\n", stats->copy_errors);
+
+	return 0;
+}
+
+static int idmf_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, idmf_stats_show, PDE_DATA(inode));
+}
+
+/* any write resets the statistics */
+static ssize_t idmf_stats_write(struct file *file, const char __user *buf,
+		size_t count, loff_t *ppos)
+{
+	struct idmf_board *board = ((struct seq_file *)file->private_data)->private;
+
+	memset(&board->stats, 0, sizeof(board->stats));
+
+	return count;
+}
+
+static const struct file_operations idmf_stats_fops = {
+	.owner = THIS_MODULE,
+	.open = idmf_stats_open,
+	.read = seq_read,
+	.write = idmf_stats_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static void idmf_vm_open(struct vm_area_struct *vma)
+{
+	struct idmf_board *board = vma->vm_private_data;
+
+	atomic_inc(&board->map_count);
+	idmf_board_get(board);
+}
+
+static void idmf_vm_close(struct vm_area_struct *vma)
+{
+	struct idmf_board *board = vma->vm_private_data;
+
+	atomic_dec(&board->map_count);
+	idmf_board_unmap(board);
+}
+
+static struct vm_operations_struct idmf_vm_ops = {
+	.open = idmf_vm_open,
+	.close = idmf_vm_close,
+};
+
+/**
+ * idmf_mmap_regs - map the register window into the caller's address space
+ * @board:	the board
+ * @user_info:	the calling process
+ * @arg:	user pointer to struct idmf_mmap
+ *
+ * Every mapping holds a reference to the board, so the PCI resources are
+ * only released when the last mapping is gone, see idmf_board_put. The window
+ * bypasses the claims of idmf_claim, so it cannot be mapped while any
+ * resource of the board is claimed.
+ */
+static int idmf_mmap_regs(struct idmf_board *board,
+		rtdm_user_info_t *user_info, void __user *arg)
+{
+	struct idmf_mmap map;
+	rtdm_lockctx_t lock_ctx;
+	void *ptr;
+	int err = 0;
+
+	/* mappings can only be established from non-realtime context */
+	if (rtdm_in_rt_context())
+		return -ENOSYS;
+
+	if (!user_info)
+		return -EPERM;
+
+	if (pci_resource_len(board->pdev, 0) < IDMF_REG_WINDOW)
+		return -ENODEV;
+
+	/*
+	 * The mapping is counted before it is established, so idmf_claim
+	 * refuses new claims from now on. vm_ops->open is not called for the
+	 * initial mapping.
+	 */
+	rtdm_lock_get_irqsave(&board->owner.lock, lock_ctx);
+	if (idmf_claim_empty(&board->owner.claimed))
+		atomic_inc(&board->map_count);
+	else
+		err = -EBUSY;
+	rtdm_lock_put_irqrestore(&board->owner.lock, lock_ctx);
+
+	if (err)
+		return err;
+
+	map.size = PAGE_ALIGN(IDMF_REG_WINDOW);
+
+	err = rtdm_iomap_to_user(user_info, pci_resource_start(board->pdev, 0),
+			map.size, PROT_READ | PROT_WRITE, &ptr, &idmf_vm_ops, board);
+	if (err) {
+		atomic_dec(&board->map_count);
+		rtdm_printk("idmf_drv: %s: rtdm_iomap_to_user failed\n",
+				__PRETTY_FUNCTION__);
+		return err;
+	}
+
+	idmf_board_get(board);
+
+	map.addr = (unsigned long)ptr;
+
+	if (copy_to_user(arg, &map, sizeof(map))) {
+		rtdm_munmap(user_info, ptr, map.size);
+		return -EFAULT;
+	}
+
+	return 0;
+}
+
+static int idmf_ioctl_cmd(struct idmf_board *board, struct idmf_ctx *ctx,
+		rtdm_user_info_t *user_info, unsigned int request,
+		void __user *arg)
+{
+	switch (request) {
+	case IDMF_RTIOC_XACT:
+		return idmf_xact(board, ctx, arg);
+	case IDMF_RTIOC_ADC_CONVERT:
+		return idmf_adc_convert_user(board, arg);
+	case IDMF_RTIOC_MMAP_REGS:
+		return idmf_mmap_regs(board, user_info, arg);
+	case IDMF_RTIOC_ACQ_START:
+		return idmf_acq_start(board, arg);
+	case IDMF_RTIOC_ACQ_STOP:
+		return idmf_acq_stop(board);
+	case IDMF_RTIOC_ACQ_STATUS:
+		return idmf_acq_status(board, arg);
+	case IDMF_RTIOC_ACQ_MMAP:
+		return idmf_acq_mmap(board, user_info, arg);
+	case IDMF_RTIOC_ACQ_WAIT:
+		return idmf_acq_wait_user(board, arg);
+	case IDMF_RTIOC_IRQ_WAIT:
+		return idmf_irq_wait(board, arg);
+	case IDMF_RTIOC_SNAPSHOT:
+		return idmf_snapshot(board, arg);
+	case IDMF_RTIOC_OUT_COMMIT:
+		return idmf_out_commit(board, ctx, arg);
+	case IDMF_RTIOC_ADC_REF:
+		return idmf_adc_ref(board, arg);
+	case IDMF_RTIOC_TRACE_CTL:
+		return idmf_trace_ctl(board, arg);
+	case IDMF_RTIOC_TRACE_DUMP:
+		return idmf_trace_dump(board, arg);
+	case IDMF_RTIOC_GROUP_SNAPSHOT:
+		return idmf_group_snapshot(arg);
+	case IDMF_RTIOC_ADC_ACCUM:
+		return idmf_adc_accum(board, arg);
+	case IDMF_RTIOC_ENC_TRACK:
+		return idmf_enc_track(board, arg);
+	case IDMF_RTIOC_MON_START:
+		return idmf_mon_start(board, arg);
+	case IDMF_RTIOC_MON_STOP:
+		return idmf_mon_stop(board);
+	case IDMF_RTIOC_MON_READ:
+		return idmf_mon_read(board, arg);
+	case IDMF_RTIOC_BIT_OP:
+		return idmf_bit_op(board, ctx, arg);
+	case IDMF_RTIOC_CLAIM:
+		return idmf_claim(board, ctx, arg);
+	case IDMF_RTIOC_RELEASE:
+		return idmf_release(board, ctx, arg);
+	case IDMF_RTIOC_ADC_SUBMIT:
+		return idmf_adc_submit(board, ctx, arg);
+	case IDMF_RTIOC_ADC_WAIT:
+		return idmf_adc_wait(board, ctx, arg);
+	case IDMF_RTIOC_PROG_LOAD:
+		return idmf_prog_load(board, ctx, arg);
+	case IDMF_RTIOC_PROG_UNLOAD:
+		return idmf_prog_unload(ctx, arg);
+	case IDMF_RTIOC_PROG_RUN:
+		return idmf_prog_run(board, ctx, arg);
+	default:
+		return -ENOTTY;
+	}
+}
+
+static int idmf_ioctl_reg(struct idmf_board *board, struct idmf_ctx *ctx,
 		unsigned int request, void *arg)
 {
-	struct idmf_board *board = NULL;
 	u32 value;
 	long retval = 0;
 
-	board = (struct idmf_board *)(context->device->device_data);
-
-	if(!board)
-		goto leave;
-
 	if (request & 0x03) {
 		rtdm_printk( "idmf_drv: %s: request must be a multiple of 4\n",
 				__PRETTY_FUNCTION__);
@@ -92,19 +3247,25 @@ int idmf_ioctl(struct rtdm_dev_context *context, rtdm_user_info_t *user_info,
 	if (request & REG_WRITE) {
 		retval = copy_from_user(&value, arg, sizeof(value));
 		if (retval) {
+			board->stats.copy_errors++;
 			rtdm_printk( "idmf_drv: %s: copy_from_user failed\n",
 					__PRETTY_FUNCTION__);
 			goto leave;
 		}
 
-		iowrite32(value, (u8 *)board->base + (request & 0xFFFC));
+		retval = idmf_claim_check_reg(board, ctx, request & 0xFFFC);
+		if (retval)
+			goto leave;
+
+		idmf_reg_write_bypass(board, request & 0xFFFC, value);
 	}
 
 	if (request & REG_READ) {
-		value = ioread32((u8 *)board->base + (request & 0xFFFC));
+		value = idmf_reg_read(board, request & 0xFFFC);
 
 		retval = copy_to_user(arg, &value, sizeof(value));
 		if (retval) {
+			board->stats.copy_errors++;
 			rtdm_printk( "idmf_drv: %s: copy_to_user failed\n",
 					__PRETTY_FUNCTION__);
 			goto leave;
@@ -118,24 +3279,91 @@ int idmf_ioctl(struct rtdm_dev_context *context, rtdm_user_info_t *user_info,
 	return retval;
 }
 
+//static long idmf_ioctl(struct rtdm_dev_context *context, rtdm_user_info_t *user_info,
+//		unsigned int request, void *arg)
+int idmf_ioctl(struct rtdm_dev_context *context, rtdm_user_info_t *user_info,
+		unsigned int request, void *arg)
+{
+	struct idmf_board *board = NULL;
+	struct idmf_ctx *ctx = rtdm_context_to_private(context);
+	nanosecs_abs_t start;
+	int index;
+	int ret;
+
+	board = (struct idmf_board *)(context->device->device_data);
+
+	if(!board)
+		return 0;
+
+	start = rtdm_clock_read();
+
+	if (_IOC_TYPE(request) == IDMF_RTIOC_TYPE) {
+		ret = idmf_ioctl_cmd(board, ctx, user_info, request, arg);
+		if (ret == -EFAULT)
+			board->stats.copy_errors++;
+
+		if (_IOC_NR(request) >= IDMF_STAT_IOCTLS)
+			return ret;
+		index = IDMF_STAT_IOCTL + _IOC_NR(request);
+	} else {
+		ret = idmf_ioctl_reg(board, ctx, request, arg);
+		index = (request & REG_WRITE) ? IDMF_STAT_REG_WRITE
+				: IDMF_STAT_REG_READ;
+	}
+
+	idmf_stats_record(board, index, rtdm_clock_read() - start);
+
+	return ret;
+}
+
 int idmf_open(struct rtdm_dev_context *context, rtdm_user_info_t * user_info,
 		int oflags) {
+	struct idmf_ctx *ctx = rtdm_context_to_private(context);
+
+	memset(ctx, 0, sizeof(*ctx));
+	rtdm_lock_init(&ctx->prog_lock);
+
 	return 0;
 }
 
+/* the claims of the file are released and its programs are freed */
 int idmf_close(struct rtdm_dev_context *context, rtdm_user_info_t * user_info) {
+	struct idmf_board *board = context->device->device_data;
+	struct idmf_ctx *ctx = rtdm_context_to_private(context);
+	rtdm_lockctx_t lock_ctx;
+	int i;
+
+	/* programs are freed in non-realtime context, RTDM calls us again */
+	if (rtdm_in_rt_context())
+		for (i = 0; i < IDMF_PROG_MAX; i++)
+			if (ctx->prog[i])
+				return -ENOSYS;
+
+	for (i = 0; i < IDMF_PROG_MAX; i++)
+		idmf_prog_remove(ctx, i);
+
+	if (!board)
+		return 0;
+
+	rtdm_lock_get_irqsave(&board->owner.lock, lock_ctx);
+	idmf_claim_remove(&board->owner.claimed, &ctx->claim);
+	rtdm_lock_put_irqrestore(&board->owner.lock, lock_ctx);
+
+	memset(&ctx->claim, 0, sizeof(ctx->claim));
+
 	return 0;
 }
 
 static struct rtdm_device rtdm_idmf_device_tmpl = { .struct_version =
 		RTDM_DEVICE_STRUCT_VER,
 
-.device_flags = RTDM_NAMED_DEVICE, .context_size = 0, .device_name = "",
+.device_flags = RTDM_NAMED_DEVICE, .context_size = sizeof(struct idmf_ctx), .device_name = "",
 
 .open_nrt = idmf_open, .open_rt = idmf_open,
 
 .ops = { .close_nrt = idmf_close, .close_rt = idmf_close, .ioctl_nrt =
-		idmf_ioctl, .ioctl_rt = idmf_ioctl, },
+		idmf_ioctl, .ioctl_rt = idmf_ioctl, .read_nrt = idmf_read, .read_rt =
+		idmf_read, },
 
 .device_class = RTDM_CLASS_EXPERIMENTAL, .device_sub_class =
 		RTDM_SUBCLASS_GENERIC, .profile_version = 1, .driver_name = driver_name,
@@ -149,19 +3377,17 @@ static void idmf_pci_remove(struct pci_dev *pdev) {
 	struct list_head *ptr;
 	struct idmf_board *idmfptr = NULL;
 	struct idmf_board *board = (struct idmf_board *) pci_get_drvdata(pdev);
+	rtdm_lockctx_t lock_ctx;
 
 	rtdm_printk("idmf_drv: %s\n",
 			__PRETTY_FUNCTION__);
 
-	if (board->init_flags & INIT_PCI_IOMAP)
-		pci_iounmap(pdev, board->base);
-
-	if (board->init_flags & INIT_PCI_REQUEST_REGIONS)
-		pci_release_regions(pdev);
+	if (!board)
+		return;
 
-	if (board->init_flags & INIT_PCI_ENABLE)
-		pci_disable_device(pdev);
+	pci_set_drvdata(pdev, NULL);
 
+	rtdm_lock_get_irqsave(&idmf_list_lock, lock_ctx);
 	list_for_each(ptr, &idmf_list)
 	{
 		idmfptr = list_entry(ptr, struct idmf_board, list);
@@ -170,19 +3396,48 @@ static void idmf_pci_remove(struct pci_dev *pdev) {
 		{
 			list_del(ptr);
 
-			kfree(idmfptr);
-
 			--pci_registered;
 
 			break;
 		}
 	}
+	rtdm_lock_put_irqrestore(&idmf_list_lock, lock_ctx);
+
+	/* a group snapshot may still be sampling the board */
+	while (atomic_read(&board->snapshots))
+		msleep(1);
+
+	if (atomic_read(&board->map_count) > 0
+			|| atomic_read(&board->acq.map_count) > 0)
+		rtdm_printk("idmf_drv: %s: %d register and %d ring mappings "
+				"keep the device until they are closed\n",
+				__PRETTY_FUNCTION__, atomic_read(&board->map_count),
+				atomic_read(&board->acq.map_count));
+
+	if (board->init_flags & INIT_PCI_REQUEST_IRQ) {
+		rtdm_irq_free(&board->irq.handle);
+		rtdm_event_destroy(&board->irq.event);
+	}
+
+	if (board->init_flags & INIT_ACQ)
+		idmf_acq_cleanup(board);
 
+	if (board->init_flags & INIT_MON)
+		idmf_mon_cleanup(board);
+
+	if (board->init_flags & INIT_ADC)
+		idmf_adc_cleanup(board);
+
+	board->trace.enabled = 0;
+	vfree(board->trace.ring);
+
+	idmf_board_put(board);
 }
 
 static int idmf_pci_probe(struct pci_dev *pdev, const struct pci_device_id *id) {
 	struct idmf_board *board;
 	void *base = NULL;
+	rtdm_lockctx_t lock_ctx;
 	int err = 0;
 
 	rtdm_printk("idmf_drv: %s\n", __PRETTY_FUNCTION__);
@@ -195,6 +3450,9 @@ static int idmf_pci_probe(struct pci_dev *pdev, const struct pci_device_id *id)
 		goto leave;
 	}
 
+	board->pdev = pci_dev_get(pdev);
+	atomic_set(&board->refs, 1);
+
 	pci_set_drvdata(pdev, (void *) board);
 
 	/* init pci device */
@@ -218,7 +3476,7 @@ static int idmf_pci_probe(struct pci_dev *pdev, const struct pci_device_id *id)
 	}
 	board->init_flags |= INIT_PCI_REQUEST_REGIONS;
 
-	base = pci_iomap(pdev, 0, 0x1000);
+	base = pci_iomap(pdev, 0, IDMF_REG_WINDOW);
 	if (base == NULL) {
 		rtdm_printk("idmf_drv: %s: pci_iomap failed\n", __PRETTY_FUNCTION__);
 		err = -EFAULT;
@@ -228,9 +3486,62 @@ static int idmf_pci_probe(struct pci_dev *pdev, const struct pci_device_id *id)
 
 	board->base = base;
 
-	board->pdev = pdev;
+	rtdm_lock_init(&board->adc_lock);
+	rtdm_lock_init(&board->out.lock);
+	rtdm_lock_init(&board->owner.lock);
+	rtdm_lock_init(&board->enc.lock);
+	board->enc.window = IDMF_ENC_WINDOW_NS;
+	rtdm_lock_init(&board->accum.lock);
+	idmf_accum_reset(&board->accum);
+	board->out.valid = 0;
+	board->ref.busy = 0;
+	board->ref.valid = 0;
+	board->trace.enabled = 0;
+	atomic_set(&board->trace.head, 0);
+	atomic_set(&board->map_count, 0);
+
+	err = idmf_acq_init(board);
+	if (err) {
+		rtdm_printk("idmf_drv: %s: idmf_acq_init failed\n",
+				__PRETTY_FUNCTION__);
+		goto leave;
+	}
+	board->init_flags |= INIT_ACQ;
+
+	err = idmf_mon_init(board);
+	if (err) {
+		rtdm_printk("idmf_drv: %s: idmf_mon_init failed\n",
+				__PRETTY_FUNCTION__);
+		goto leave;
+	}
+	board->init_flags |= INIT_MON;
+
+	err = idmf_adc_init(board);
+	if (err) {
+		rtdm_printk("idmf_drv: %s: idmf_adc_init failed\n",
+				__PRETTY_FUNCTION__);
+		goto leave;
+	}
+	board->init_flags |= INIT_ADC;
+
+	if (use_irq && pdev->irq) {
+		rtdm_event_init(&board->irq.event, 0);
+		rtdm_lock_init(&board->irq.lock);
+
+		err = rtdm_irq_request(&board->irq.handle, pdev->irq,
+				idmf_irq_handler, RTDM_IRQTYPE_SHARED, driver_name, board);
+		if (err) {
+			rtdm_printk("idmf_drv: %s: rtdm_irq_request failed\n",
+					__PRETTY_FUNCTION__);
+			rtdm_event_destroy(&board->irq.event);
+			goto leave;
+		}
+		board->init_flags |= INIT_PCI_REQUEST_IRQ;
+	}
 
+	rtdm_lock_get_irqsave(&idmf_list_lock, lock_ctx);
 	list_add(&board->list, &idmf_list);
+	rtdm_lock_put_irqrestore(&idmf_list_lock, lock_ctx);
 
 	leave:
 
@@ -269,6 +3580,8 @@ static int idmf_init(void) {
 	struct idmf_board *idmfptr = NULL;
 	struct rtdm_device * device;
 
+	rtdm_lock_init(&idmf_list_lock);
+
 	idmf_pci_init();
 
 	list_for_each(ptr, &idmf_list)
@@ -303,6 +3616,10 @@ static int idmf_init(void) {
 
 		device->device_data = (void *)idmfptr;
 
+		if (device->proc_entry)
+			idmfptr->stats_entry = proc_create_data("stats", 0644,
+					device->proc_entry, &idmf_stats_fops, idmfptr);
+
 		++index;
 
 	}
@@ -323,6 +3640,9 @@ static void idmf_cleanup(void) {
 
 		rtdm_printk("idmf_drv: unregister device %s in %s\n",
 				idmfptr->dev->device_name, __PRETTY_FUNCTION__);
+		if (idmfptr->stats_entry)
+			remove_proc_entry("stats", idmfptr->dev->proc_entry);
+
 		rtdm_dev_unregister(idmfptr->dev, 1000);
 
 		kfree(idmfptr->dev);
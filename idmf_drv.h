@@ -23,13 +23,382 @@
 #include <linux/pci.h>
 #include <linux/device.h>
 #include <linux/cdev.h>
+#include <linux/wait.h>
+#include <linux/mutex.h>
 
-#define MAX_BOARD_COUNT 6
+#include <rtdm/rtdm_driver.h>
+
+#include "idmf_ioctl.h"
+
+#define MAX_BOARD_COUNT IDMF_GROUP_MAX
+
+/**
+ * idmf_acq - periodic acquisition of a board
+ * @task:	acquisition task
+ * @config:	configuration of the running acquisition
+ * @area:	memory holding @shm and @ring, mappable into user space
+ * @area_size:	size of @area
+ * @shm:	ring header with the producer and consumer indices
+ * @ring:	single-producer ring of samples
+ * @frames:	number of samples held by @ring
+ * @map_count:	number of user space mappings of @area
+ * @reader:	1 while a read consumes samples
+ * @users:	number of reads and waits using @ring, -1 while @area is
+ *		reallocated
+ * @ready:	signalled for realtime readers when a sample was added
+ * @nrt_ready:	wakes @nrt_wait for non-realtime readers
+ * @nrt_waiters: number of non-realtime readers sleeping on @nrt_wait
+ * @lock:	serializes start and stop
+ */
+struct idmf_acq {
+	rtdm_task_t		task;
+	int			running;
+	int			stop;
+
+	struct idmf_acq_config	config;
+
+	void			*area;
+	size_t			area_size;
+	struct idmf_ring	*shm;
+	struct idmf_sample	*ring;
+	u32			frames;
+	atomic_t		map_count;
+	atomic_t		reader;
+	atomic_t		users;
+
+	u64			samples;
+
+	rtdm_event_t		ready;
+	rtdm_nrtsig_t		nrt_ready;
+	wait_queue_head_t	nrt_wait;
+	atomic_t		nrt_waiters;
+
+	struct mutex		lock;
+};
+
+/**
+ * idmf_mon - edge monitor of a board
+ * @task:	sampling task, runs when config.period_ns is not 0
+ * @running:	@task has been started
+ * @stop:	set to terminate @task
+ * @config:	configuration of the running monitor
+ * @sample_lock: serializes the samples of @task and the interrupt handler
+ * @active:	samples are taken
+ * @primed:	@gpio and @port hold a previous sample
+ * @gpio:	GPIO_IN at the previous sample
+ * @port:	PRT_VALUE at the previous sample
+ * @ring:	IDMF_MON_EVENTS events, allocated on the first start
+ * @head:	index of the next event written by the samples
+ * @tail:	index of the next event to be read
+ * @lost:	events dropped since the previous read
+ * @reader:	1 while a read consumes events
+ * @ready:	signalled for realtime readers when events were added
+ * @nrt_ready:	wakes @nrt_wait for non-realtime readers
+ * @nrt_waiters: number of non-realtime readers sleeping on @nrt_wait
+ * @lock:	serializes start and stop
+ */
+struct idmf_mon {
+	rtdm_task_t		task;
+	int			running;
+	int			stop;
+
+	struct idmf_mon_config	config;
+
+	rtdm_lock_t		sample_lock;
+	int			active;
+	int			primed;
+	u32			gpio;
+	u8			port[NUM_PORTS];
+
+	struct idmf_mon_event	*ring;
+	u32			head;
+	u32			tail;
+	u32			lost;
+	atomic_t		reader;
+
+	rtdm_event_t		ready;
+	rtdm_nrtsig_t		nrt_ready;
+	wait_queue_head_t	nrt_wait;
+	atomic_t		nrt_waiters;
+
+	struct mutex		lock;
+};
+
+/* steps of struct idmf_adc_async */
+#define IDMF_ADC_PHASE_START	0	/* release the request, start converting */
+#define IDMF_ADC_PHASE_DRAIN	1	/* read the samples */
+
+/**
+ * idmf_adc_async - split-phase ADC conversion
+ * @timer:	runs the steps of the conversion
+ * @phase:	IDMF_ADC_PHASE_* step run by the next expiry of @timer
+ * @busy:	a conversion is in progress or the ADC is claimed by a sequence
+ *		run without the ADC lock, synchronous conversions wait
+ * @seq:	sequence number of the last submitted conversion, never 0
+ * @done:	sequence number of the last completed conversion
+ * @timestamp:	start of the conversion in progress
+ * @frame:	samples of conversion @done
+ * @ready:	signalled for realtime waiters when a conversion completed
+ * @nrt_ready:	wakes @nrt_wait for non-realtime waiters
+ * @nrt_waiters: number of non-realtime waiters sleeping on @nrt_wait
+ *
+ * @busy, @seq, @done, @timestamp and @frame are protected by the ADC lock
+ * of the board.
+ */
+struct idmf_adc_async {
+	rtdm_timer_t		timer;
+	int			phase;
+
+	int			busy;
+	u32			seq;
+	u32			done;
+	u64			timestamp;
+	struct idmf_adc_frame	frame;
+
+	rtdm_event_t		ready;
+	rtdm_nrtsig_t		nrt_ready;
+	wait_queue_head_t	nrt_wait;
+	atomic_t		nrt_waiters;
+};
+
+/**
+ * idmf_accum - ADC conversions accumulated by the acquisition task
+ * @lock:	protects all other members
+ * @count:	number of conversions accumulated
+ * @first:	time of the first conversion
+ * @last:	time of the last conversion
+ * @sum:	sum of the samples of each channel
+ * @min:	smallest sample of each channel
+ * @max:	largest sample of each channel
+ */
+struct idmf_accum {
+	rtdm_lock_t	lock;
+
+	u32		count;
+	u64		first;
+	u64		last;
+	s64		sum[NUM_ADCS];
+	s16		min[NUM_ADCS];
+	s16		max[NUM_ADCS];
+};
+
+/* readings of an encoder kept for the velocity, a power of two */
+#define IDMF_ENC_HISTORY	32
+
+/**
+ * idmf_enc_chan - tracking of an encoder channel
+ * @valid:	the other members describe a previous reading
+ * @raw:	MFC_CNT at the last reading
+ * @velocity:	velocity at the last reading in counts per second
+ * @position:	unwrapped position at the last reading
+ * @timestamp:	time of the last reading
+ * @head:	number of readings recorded in @time and @pos
+ * @time:	time of the recorded readings, at least window /
+ *		IDMF_ENC_HISTORY apart
+ * @pos:	unwrapped position of the recorded readings
+ */
+struct idmf_enc_chan {
+	int		valid;
+	u32		raw;
+	s32		velocity;
+	s64		position;
+	u64		timestamp;
+	u32		head;
+	u64		time[IDMF_ENC_HISTORY];
+	s64		pos[IDMF_ENC_HISTORY];
+};
+
+/**
+ * idmf_enc - encoder tracking of a board
+ * @lock:	protects all other members
+ * @window:	velocity window in nanoseconds
+ * @chan:	the channels
+ */
+struct idmf_enc {
+	rtdm_lock_t	lock;
+	u64		window;
+	struct idmf_enc_chan chan[NUM_ENCS];
+};
+
+/**
+ * idmf_irq - interrupt state of a board
+ * @handle:	RTDM interrupt handle
+ * @event:	signalled by the interrupt handler
+ * @lock:	protects @sources, @count and @timestamp
+ * @sources:	interrupt sources not yet reported to a waiter
+ * @count:	number of interrupts handled
+ * @timestamp:	time of the last interrupt
+ */
+struct idmf_irq {
+	rtdm_irq_t	handle;
+	rtdm_event_t	event;
+	rtdm_lock_t	lock;
+
+	u32		sources;
+	u32		count;
+	u64		timestamp;
+};
+
+/**
+ * idmf_out - values last written to the output registers
+ * @lock:	serializes output commits
+ * @valid:	IDMF_OUT_VALID_* bits of the values known to match the board
+ * @dac:	DAC_VALUE
+ * @port:	PRT_VALUE
+ * @gpio:	GPIO_OUT
+ * @led:	BCT_LED
+ */
+struct idmf_out {
+	rtdm_lock_t	lock;
+	u32		valid;
+
+	s16		dac[NUM_DACS];
+	u8		port[NUM_PORTS];
+	u32		gpio;
+	u32		led;
+};
+
+/**
+ * idmf_owner - resources claimed by the open files of a board
+ * @lock:	protects @claimed and the claims of all contexts
+ * @claimed:	union of the claims, the claims of the contexts are disjoint
+ */
+struct idmf_owner {
+	rtdm_lock_t	lock;
+	struct idmf_claim claimed;
+};
+
+/**
+ * idmf_prog - validated register program
+ * @users:	number of running executions, the program is freed at 0
+ * @use:	resources written by the program
+ * @in_slots:	number of input slots read by the program
+ * @out_slots:	number of output slots written by the program
+ * @count:	number of operations
+ * @ops:	the operations
+ */
+struct idmf_prog {
+	atomic_t	users;
+	struct idmf_claim use;
+	u32		in_slots;
+	u32		out_slots;
+	u32		count;
+	struct idmf_prog_op ops[0];
+};
+
+/**
+ * idmf_ctx - private data of an open file
+ * @claim:	resources claimed through the file
+ * @adc_seq:	last ADC conversion submitted through the file, 0 if none
+ * @prog_lock:	protects @prog
+ * @prog:	register programs by handle
+ */
+struct idmf_ctx {
+	struct idmf_claim claim;
+	u32		adc_seq;
+
+	rtdm_lock_t	prog_lock;
+	struct idmf_prog *prog[IDMF_PROG_MAX];
+};
+
+/**
+ * idmf_ref - references last programmed into the board
+ * @busy:	bit 0 is set while the references are programmed
+ * @valid:	@refadc and @refina are known to match the board
+ * @refadc:	reference voltage of ADC
+ * @refina:	reference voltage of INA
+ */
+struct idmf_ref {
+	unsigned long	busy;
+	int		valid;
+	u16		refadc;
+	u16		refina;
+};
+
+/**
+ * idmf_trace - register access trace
+ * @enabled:	non-zero while accesses are recorded
+ * @head:	sequence number of the next entry
+ * @ring:	IDMF_TRACE_FRAMES entries, allocated on the first enable
+ *
+ * Writers claim an entry by incrementing @head. The seq field of an entry
+ * is IDMF_TRACE_BUSY while it is written and its sequence number once it
+ * is complete, so readers never block writers. Writers skip the sequence
+ * number IDMF_TRACE_BUSY when @head wraps.
+ */
+struct idmf_trace {
+	int		enabled;
+	atomic_t	head;
+
+	struct idmf_trace_entry *ring;
+};
+
+/* latency histograms of struct idmf_stats */
+#define IDMF_STAT_REG_READ	0	/* legacy register read */
+#define IDMF_STAT_REG_WRITE	1	/* legacy register write */
+#define IDMF_STAT_READ		2	/* read of samples */
+#define IDMF_STAT_ACQ		3	/* cycle of the acquisition task */
+#define IDMF_STAT_IOCTL		4	/* IDMF_RTIOC_* request, by number */
+#define IDMF_STAT_IOCTLS	32
+#define IDMF_STAT_HISTS		(IDMF_STAT_IOCTL + IDMF_STAT_IOCTLS)
+
+/* bucket n counts durations below 2^n ns */
+#define IDMF_STAT_BUCKETS	32
+
+/**
+ * idmf_stat_hist - latency histogram
+ * @count:	number of recorded durations
+ * @total:	sum of the durations in ns
+ * @max:	worst case in ns
+ * @bucket:	log2 histogram
+ */
+struct idmf_stat_hist {
+	u32		count;
+	u64		total;
+	u64		max;
+	u32		bucket[IDMF_STAT_BUCKETS];
+};
+
+/**
+ * idmf_stats - runtime statistics of a board
+ * @reads:	register reads by register
+ * @writes:	register writes by register
+ * @copy_errors: failed copies from or to user space
+ * @hist:	latency histograms, see IDMF_STAT_*
+ *
+ * The counters are updated without locking; updates of concurrent callers
+ * may occasionally be lost.
+ */
+struct idmf_stats {
+	u32		reads[IDMF_REG_WINDOW / 4];
+	u32		writes[IDMF_REG_WINDOW / 4];
+	u32		copy_errors;
+
+	struct idmf_stat_hist hist[IDMF_STAT_HISTS];
+};
 
 /**
  * idmf_board
  * @pdev:	pci device structure
  * @base:	pointer to start of io memory
+ * @adc_lock:	protects @adc, conversion sequences claim the ADC through
+ *		adc.busy and run without it
+ * @adc:	asynchronous ADC conversion
+ * @refs:	held by the PCI device and by every user space mapping
+ * @map_count:	number of user space mappings of the register window
+ * @snapshots:	number of group snapshots using the board, removal waits for
+ *		them
+ * @acq:	periodic acquisition
+ * @accum:	ADC conversions accumulated by the acquisition
+ * @enc:	encoder tracking
+ * @mon:	edge monitor
+ * @irq:	interrupt state
+ * @out:	output shadow
+ * @owner:	resources claimed by open files
+ * @ref:	ADC reference cache
+ * @stats:	runtime statistics
+ * @stats_entry: proc entry of @stats
+ * @trace:	register access trace
  */
 struct idmf_board {
 	struct list_head list;
@@ -41,6 +410,31 @@ struct idmf_board {
 	u32 __iomem	*base;
 
 	u32	init_flags;
+
+	rtdm_lock_t	adc_lock;
+
+	atomic_t	refs;
+	atomic_t	map_count;
+	atomic_t	snapshots;
+
+	struct idmf_adc_async adc;
+
+	struct idmf_acq	acq;
+	struct idmf_accum accum;
+	struct idmf_enc	enc;
+	struct idmf_mon	mon;
+
+	struct idmf_irq	irq;
+
+	struct idmf_out	out;
+	struct idmf_owner owner;
+
+	struct idmf_ref	ref;
+
+	struct idmf_stats stats;
+	struct proc_dir_entry *stats_entry;
+
+	struct idmf_trace trace;
 };
 
 #endif /* __IDMF_DRV_H */
@@ -0,0 +1,399 @@
+/*
+ * Author Wojciech Domski 2015
+ * www.domski.pl
+ *
+ * I/O engine running one Xenomai realtime worker per board.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <native/task.h>
+#include <native/sem.h>
+#include <native/event.h>
+
+#include "idmf_engine.h"
+
+/* time in nanoseconds a reader sleeps while a slot is written */
+#define ENGINE_FETCH_BACKOFF	1000
+
+/**
+ * engine_slot - snapshot published by a worker
+ * @seq:	odd while the slot is written
+ * @cycle:	cycle the snapshot was taken in
+ * @status:	result of the snapshot
+ * @snap:	the snapshot
+ */
+struct engine_slot {
+	__u32 seq;
+	int status;
+	__u64 cycle;
+	struct idmf_snapshot snap;
+};
+
+/**
+ * engine_worker - worker of a board
+ * @engine:	the engine
+ * @index:	index of the board
+ * @board:	the board
+ * @task:	the realtime task
+ * @task_created: @task has been created and started
+ * @start:	released once per cycle
+ * @start_created: @start has been created
+ * @cycle:	cycle the worker was last released for
+ * @out:	outputs committed at the start of the next cycle
+ * @out_pending: @out is valid
+ * @slot:	last snapshot
+ */
+struct engine_worker {
+	idmf_engine *engine;
+	int index;
+
+	idmf_board *board;
+
+	RT_TASK task;
+	int task_created;
+	RT_SEM start;
+	int start_created;
+	__u64 cycle;
+
+	struct idmf_out_frame out;
+	int out_pending;
+
+	struct engine_slot slot;
+};
+
+/**
+ * idmf_engine - workers of all boards
+ * @boards:	number of boards
+ * @stop:	set to terminate the workers
+ * @cycle:	number of the current cycle
+ * @late:	bit n is set while worker n is still busy with an earlier cycle
+ * @done:	bit n is signalled by worker n at the end of a cycle
+ * @done_created: @done has been created
+ * @worker:	the workers
+ */
+struct idmf_engine {
+	int boards;
+	int stop;
+	__u64 cycle;
+	unsigned long late;
+
+	RT_EVENT done;
+	int done_created;
+
+	struct engine_worker worker[IDMF_ENGINE_MAX];
+};
+
+/*
+ * The slots are written by one worker and read by any thread at any time.
+ * Readers retry when the sequence number was odd or changed during the copy.
+ * A reader finding the slot being written sleeps before it retries, so a
+ * worker preempted by a reader of higher priority can finish the write.
+ */
+static void slot_publish(struct engine_slot *slot, __u64 cycle, int status,
+		const struct idmf_snapshot *snap) {
+	__u32 seq = slot->seq;
+
+	__atomic_store_n(&slot->seq, seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	slot->cycle = cycle;
+	slot->status = status;
+	slot->snap = *snap;
+
+	__atomic_store_n(&slot->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+static void slot_fetch(struct engine_slot *slot, __u64 *cycle, int *status,
+		struct idmf_snapshot *snap) {
+	__u32 seq;
+
+	for (;;) {
+		seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+		if (seq & 1) {
+			rt_task_sleep(ENGINE_FETCH_BACKOFF);
+			continue;
+		}
+
+		*cycle = slot->cycle;
+		*status = slot->status;
+		*snap = slot->snap;
+
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) == seq)
+			return;
+	}
+}
+
+static void engine_worker_main(void *cookie) {
+	struct engine_worker *worker = cookie;
+	idmf_engine *engine = worker->engine;
+	struct idmf_snapshot snap;
+	int err;
+
+	for (;;) {
+		if (rt_sem_p(&worker->start, TM_INFINITE))
+			break;
+
+		if (engine->stop)
+			break;
+
+		if (worker->out_pending) {
+			idmf_output_commit(worker->board, &worker->out);
+			worker->out_pending = 0;
+		}
+
+		err = idmf_snapshot(worker->board, &snap);
+		slot_publish(&worker->slot, worker->cycle, err, &snap);
+
+		rt_event_signal(&engine->done, 1UL << worker->index);
+	}
+}
+
+/**
+ * idmf_engine_destroy - stop the workers and close the boards
+ * @engine:	the engine
+ *
+ * This function must not be called while idmf_engine_cycle is running.
+ */
+void idmf_engine_destroy(idmf_engine *engine) {
+	struct engine_worker *worker;
+	int i;
+
+	engine->stop = 1;
+
+	for (i = 0; i < engine->boards; i++) {
+		worker = &engine->worker[i];
+
+		if (worker->task_created) {
+			rt_sem_v(&worker->start);
+			rt_task_join(&worker->task);
+		}
+
+		if (worker->start_created)
+			rt_sem_delete(&worker->start);
+
+		if (worker->board)
+			idmf_close(worker->board);
+	}
+
+	if (engine->done_created)
+		rt_event_delete(&engine->done);
+
+	free(engine);
+}
+
+/**
+ * idmf_engine_create - open the boards and start their workers
+ * @config:	the configuration
+ *
+ * The workers are Xenomai tasks of the native skin, the memory of the
+ * process has to be locked with mlockall before.
+ *
+ * This function returns the engine or NULL on failure.
+ */
+idmf_engine * idmf_engine_create(const struct idmf_engine_config *config) {
+	idmf_engine *engine;
+	struct engine_worker *worker;
+	int priority;
+	int mode;
+	int i;
+
+	if (config->boards <= 0 || config->boards > IDMF_ENGINE_MAX)
+		return 0;
+
+	engine = calloc(1, sizeof(*engine));
+	if (!engine)
+		return 0;
+
+	engine->boards = config->boards;
+
+	priority = config->priority ? config->priority : IDMF_ENGINE_PRIORITY;
+
+	if (rt_event_create(&engine->done, NULL, 0, EV_PRIO))
+		goto fail;
+	engine->done_created = 1;
+
+	for (i = 0; i < engine->boards; i++) {
+		worker = &engine->worker[i];
+		worker->engine = engine;
+		worker->index = i;
+
+		worker->board = idmf_open_ex(config->devices[i], config->flags);
+		if (!worker->board)
+			goto fail;
+
+		if (rt_sem_create(&worker->start, NULL, 0, S_FIFO))
+			goto fail;
+		worker->start_created = 1;
+
+		mode = T_FPU | T_JOINABLE;
+		if (config->pinned & (1UL << i))
+			mode |= T_CPU(config->cpus[i]);
+
+		if (rt_task_create(&worker->task, NULL, 0, priority, mode))
+			goto fail;
+
+		/* a task which never ran can not be joined */
+		if (rt_task_start(&worker->task, engine_worker_main, worker)) {
+			rt_task_delete(&worker->task);
+			goto fail;
+		}
+		worker->task_created = 1;
+	}
+
+	return engine;
+
+	fail:
+
+	idmf_engine_destroy(engine);
+
+	return 0;
+}
+
+/**
+ * idmf_engine_board - get a board of an engine
+ * @engine:	the engine
+ * @board:	index of the board
+ *
+ * The board may be used for configuration between cycles.
+ */
+idmf_board * idmf_engine_board(idmf_engine *engine, int board) {
+	if (board < 0 || board >= engine->boards)
+		return 0;
+
+	return engine->worker[board].board;
+}
+
+/**
+ * idmf_engine_set_output - set the outputs of a board for the next cycle
+ * @engine:	the engine
+ * @board:	index of the board
+ * @frame:	the outputs, see idmf_output_commit
+ *
+ * The outputs are committed by the worker at the start of the next cycle,
+ * before the inputs are sampled. This function must not be called while
+ * idmf_engine_cycle is running.
+ *
+ * This function returns 0 or a negative error code, -EBUSY while the worker
+ * of the board is late from an earlier cycle and may still be reading the
+ * previous outputs.
+ */
+int idmf_engine_set_output(idmf_engine *engine, int board,
+		const struct idmf_out_frame *frame) {
+	struct engine_worker *worker;
+
+	if (board < 0 || board >= engine->boards)
+		return -EINVAL;
+
+	if (engine->late & (1UL << board))
+		return -EBUSY;
+
+	worker = &engine->worker[board];
+	worker->out = *frame;
+	worker->out_pending = 1;
+
+	return 0;
+}
+
+/**
+ * idmf_engine_cycle - run one cycle on all boards
+ * @engine:	the engine
+ * @frame:	the merged snapshots of the cycle, may be NULL
+ * @timeout:	timeout in nanoseconds, 0 waits infinitely
+ *
+ * All workers are released at once, commit their pending outputs and take
+ * a snapshot of their board. The function returns when all of them are
+ * done. It has to be called from a Xenomai task.
+ *
+ * This function returns 0 or a negative error code, -ETIMEDOUT when a
+ * worker did not finish in time. A late worker completes in the background
+ * and publishes its snapshot then. The next cycle waits for the late workers
+ * before it releases any worker and fails with -ETIMEDOUT without starting
+ * when they are still busy.
+ */
+int idmf_engine_cycle(idmf_engine *engine, struct idmf_engine_frame *frame,
+		__u64 timeout) {
+	unsigned long mask = (1UL << engine->boards) - 1;
+	RTIME wait = timeout ? (RTIME) timeout : TM_INFINITE;
+	unsigned long done;
+	int err;
+	int i;
+
+	/*
+	 * A late worker signals its bit whenever it completes. Clearing returns
+	 * the bits that were set, so a bit signalled after the clear stays
+	 * pending and is consumed here instead of ending a later cycle early.
+	 */
+	if (engine->late) {
+		err = rt_event_wait(&engine->done, engine->late, &done, EV_ALL,
+				wait);
+
+		rt_event_clear(&engine->done, engine->late, &done);
+		engine->late &= ~done;
+
+		if (engine->late)
+			return err ? err : -ETIMEDOUT;
+	}
+
+	engine->cycle++;
+
+	for (i = 0; i < engine->boards; i++) {
+		engine->worker[i].cycle = engine->cycle;
+		rt_sem_v(&engine->worker[i].start);
+	}
+
+	err = rt_event_wait(&engine->done, mask, &done, EV_ALL, wait);
+
+	rt_event_clear(&engine->done, mask, &done);
+	engine->late = mask & ~done;
+
+	if (err)
+		return err;
+
+	if (frame)
+		idmf_engine_latest(engine, frame);
+
+	return 0;
+}
+
+/**
+ * idmf_engine_latest - get the last snapshots of all boards
+ * @engine:	the engine
+ * @frame:	the merged snapshots
+ *
+ * The snapshots are read without blocking the workers, so this function may
+ * be called from any Xenomai task at any time. frame->cycle is the oldest cycle
+ * among the snapshots.
+ */
+void idmf_engine_latest(idmf_engine *engine, struct idmf_engine_frame *frame) {
+	__u64 cycle;
+	int i;
+
+	frame->boards = engine->boards;
+	frame->cycle = engine->cycle;
+
+	for (i = 0; i < engine->boards; i++) {
+		slot_fetch(&engine->worker[i].slot, &cycle, &frame->status[i],
+				&frame->board[i]);
+
+		if (cycle < frame->cycle)
+			frame->cycle = cycle;
+	}
+}
@@ -0,0 +1,89 @@
+/*
+ * Author Wojciech Domski 2015
+ * www.domski.pl
+ *
+ * I/O engine running one Xenomai realtime worker per board. The workers
+ * are released together every cycle, so the driver calls of the boards
+ * overlap instead of adding up.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef __IDMF_ENGINE_H
+#define __IDMF_ENGINE_H
+
+#include "idmf_api.h"
+
+/* maximum number of boards driven by an engine */
+#define IDMF_ENGINE_MAX		IDMF_GROUP_MAX
+
+/* default priority of the workers */
+#define IDMF_ENGINE_PRIORITY	80
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct idmf_engine idmf_engine;
+
+/**
+ * idmf_engine_config - configuration of an engine
+ * @boards:	number of boards
+ * @devices:	device names of the boards
+ * @pinned:	bit n pins the worker of board n to CPU @cpus[n], 0 leaves
+ *		all workers unpinned
+ * @cpus:	CPU the worker of a board is pinned to
+ * @priority:	priority of the workers, 0 selects IDMF_ENGINE_PRIORITY
+ * @flags:	IDMF_OPEN_* flags the boards are opened with
+ */
+struct idmf_engine_config {
+	int boards;
+	const char * devices[IDMF_ENGINE_MAX];
+	unsigned long pinned;
+	int cpus[IDMF_ENGINE_MAX];
+	int priority;
+	int flags;
+};
+
+/**
+ * idmf_engine_frame - merged view of all boards
+ * @cycle:	number of the cycle the snapshots were taken in
+ * @boards:	number of boards
+ * @status:	0 or the negative error code of the snapshot of a board
+ * @board:	snapshot of each board in configuration order
+ */
+struct idmf_engine_frame {
+	__u64 cycle;
+	int boards;
+	int status[IDMF_ENGINE_MAX];
+	struct idmf_snapshot board[IDMF_ENGINE_MAX];
+};
+
+idmf_engine * idmf_engine_create(const struct idmf_engine_config *config);
+void idmf_engine_destroy(idmf_engine *engine);
+
+idmf_board * idmf_engine_board(idmf_engine *engine, int board);
+
+int idmf_engine_set_output(idmf_engine *engine, int board,
+		const struct idmf_out_frame *frame);
+int idmf_engine_cycle(idmf_engine *engine, struct idmf_engine_frame *frame,
+		__u64 timeout);
+void idmf_engine_latest(idmf_engine *engine, struct idmf_engine_frame *frame);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
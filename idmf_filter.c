@@ -0,0 +1,395 @@
+/*
+ * Author Wojciech Domski 2015
+ * www.domski.pl
+ *
+ * Streaming filters and decimation of blocks of ADC or encoder frames.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <string.h>
+#include <errno.h>
+
+#include "idmf_filter.h"
+
+/*
+ * Every operation processes a whole frame as FILTER_VECS vectors of four
+ * channels, the native width of SSE and NEON. Frames in memory are not
+ * aligned, they are moved in and out of vectors with memcpy.
+ */
+#define FILTER_VEC		4
+#define FILTER_VECS		(IDMF_FILTER_LANES / FILTER_VEC)
+
+typedef float filter_vec __attribute__((vector_size(FILTER_VEC * sizeof(float))));
+
+static inline filter_vec vec_load(const float *src) {
+	filter_vec v;
+
+	memcpy(&v, src, sizeof(v));
+	return v;
+}
+
+static inline void vec_store(float *dst, filter_vec v) {
+	memcpy(dst, &v, sizeof(v));
+}
+
+static inline filter_vec vec_splat(float value) {
+	filter_vec v = { value, value, value, value };
+
+	return v;
+}
+
+/* returns 1 when the result of the current input is passed on */
+static inline int stage_emit(struct idmf_filter_stage *stage) {
+	if (++stage->phase < stage->decimation)
+		return 0;
+
+	stage->phase = 0;
+	return 1;
+}
+
+/*****************************************************************************/
+/* Stages */
+
+static size_t stage_fir(struct idmf_filter_stage *stage, const float *in,
+		float *out, size_t frames) {
+	int taps = stage->fir.taps;
+	filter_vec acc[FILTER_VECS];
+	filter_vec c;
+	size_t count = 0;
+	size_t i;
+	int pos;
+	int h;
+	int k;
+
+	for (i = 0; i < frames; i++, in += IDMF_FILTER_LANES) {
+		pos = stage->fir.pos ? stage->fir.pos - 1 : taps - 1;
+		stage->fir.pos = pos;
+
+		memcpy(stage->fir.history[pos], in, sizeof(stage->fir.history[pos]));
+		memcpy(stage->fir.history[pos + taps], in,
+				sizeof(stage->fir.history[pos]));
+
+		/* the taps of the skipped results are not computed */
+		if (!stage_emit(stage))
+			continue;
+
+		for (h = 0; h < FILTER_VECS; h++)
+			acc[h] = vec_splat(0.0f);
+
+		for (k = 0; k < taps; k++) {
+			c = vec_splat(stage->fir.coeffs[k]);
+			for (h = 0; h < FILTER_VECS; h++)
+				acc[h] += c * vec_load(stage->fir.history[pos + k]
+						+ h * FILTER_VEC);
+		}
+
+		for (h = 0; h < FILTER_VECS; h++)
+			vec_store(out + count * IDMF_FILTER_LANES + h * FILTER_VEC,
+					acc[h]);
+		count++;
+	}
+
+	return count;
+}
+
+static size_t stage_biquad(struct idmf_filter_stage *stage, const float *in,
+		float *out, size_t frames) {
+	filter_vec b0 = vec_splat(stage->biquad.b[0]);
+	filter_vec b1 = vec_splat(stage->biquad.b[1]);
+	filter_vec b2 = vec_splat(stage->biquad.b[2]);
+	filter_vec a1 = vec_splat(stage->biquad.a[0]);
+	filter_vec a2 = vec_splat(stage->biquad.a[1]);
+	filter_vec z1[FILTER_VECS];
+	filter_vec z2[FILTER_VECS];
+	filter_vec y[FILTER_VECS];
+	filter_vec x;
+	size_t count = 0;
+	size_t i;
+	int h;
+
+	for (h = 0; h < FILTER_VECS; h++) {
+		z1[h] = vec_load(stage->biquad.z1 + h * FILTER_VEC);
+		z2[h] = vec_load(stage->biquad.z2 + h * FILTER_VEC);
+	}
+
+	for (i = 0; i < frames; i++, in += IDMF_FILTER_LANES) {
+		for (h = 0; h < FILTER_VECS; h++) {
+			x = vec_load(in + h * FILTER_VEC);
+
+			y[h] = b0 * x + z1[h];
+			z1[h] = b1 * x - a1 * y[h] + z2[h];
+			z2[h] = b2 * x - a2 * y[h];
+		}
+
+		if (stage_emit(stage)) {
+			for (h = 0; h < FILTER_VECS; h++)
+				vec_store(out + count * IDMF_FILTER_LANES
+						+ h * FILTER_VEC, y[h]);
+			count++;
+		}
+	}
+
+	for (h = 0; h < FILTER_VECS; h++) {
+		vec_store(stage->biquad.z1 + h * FILTER_VEC, z1[h]);
+		vec_store(stage->biquad.z2 + h * FILTER_VEC, z2[h]);
+	}
+
+	return count;
+}
+
+#define CIC_ROUND		6755399441055744.0
+#define CIC_ROUND_BITS		0x4338000000000000ULL
+
+/*
+ * The integrators wrap around, which cancels out in the combs as long as
+ * the result fits. Unsigned arithmetic keeps the wrap around defined.
+ */
+static size_t stage_cic(struct idmf_filter_stage *stage, const float *in,
+		float *out, size_t frames) {
+	int order = stage->cic.order;
+	__u64 x[IDMF_FILTER_LANES];
+	union {
+		double f;
+		__u64 u;
+	} d;
+	__u64 prev;
+	size_t count = 0;
+	size_t i;
+	int ch;
+	int n;
+
+	for (i = 0; i < frames; i++, in += IDMF_FILTER_LANES) {
+		/*
+		 * Adding 1.5 * 2^52 rounds to an integer held in the low bits
+		 * of the mantissa, without a branch and without the slow
+		 * conversion to a 64 bit integer.
+		 */
+		for (ch = 0; ch < IDMF_FILTER_LANES; ch++) {
+			d.f = (double) in[ch] * (1 << IDMF_FILTER_CIC_SHIFT)
+					+ CIC_ROUND;
+			x[ch] = d.u - CIC_ROUND_BITS;
+		}
+
+		for (n = 0; n < order; n++)
+			for (ch = 0; ch < IDMF_FILTER_LANES; ch++)
+				x[ch] = stage->cic.integ[n][ch] += x[ch];
+
+		if (!stage_emit(stage))
+			continue;
+
+		for (n = 0; n < order; n++)
+			for (ch = 0; ch < IDMF_FILTER_LANES; ch++) {
+				prev = stage->cic.comb[n][ch];
+				stage->cic.comb[n][ch] = x[ch];
+				x[ch] -= prev;
+			}
+
+		for (ch = 0; ch < IDMF_FILTER_LANES; ch++)
+			out[count * IDMF_FILTER_LANES + ch] =
+					(float) (__s64) x[ch] * stage->cic.gain;
+		count++;
+	}
+
+	return count;
+}
+
+/*****************************************************************************/
+/* Filter functions */
+
+/**
+ * idmf_filter_init - initialize an empty filter
+ * @filter:	the filter
+ *
+ * An empty filter passes the frames unchanged.
+ */
+void idmf_filter_init(idmf_filter *filter) {
+	memset(filter, 0, sizeof(*filter));
+}
+
+/**
+ * idmf_filter_reset - clear the state of all stages
+ * @filter:	the filter
+ *
+ * The stages are kept, the filter continues as if it had been fed zeros.
+ */
+void idmf_filter_reset(idmf_filter *filter) {
+	struct idmf_filter_stage *stage;
+	int i;
+
+	for (i = 0; i < filter->stages; i++) {
+		stage = &filter->stage[i];
+
+		stage->phase = 0;
+		stage->fir.pos = 0;
+		memset(stage->fir.history, 0, sizeof(stage->fir.history));
+		memset(stage->biquad.z1, 0, sizeof(stage->biquad.z1));
+		memset(stage->biquad.z2, 0, sizeof(stage->biquad.z2));
+		memset(stage->cic.integ, 0, sizeof(stage->cic.integ));
+		memset(stage->cic.comb, 0, sizeof(stage->cic.comb));
+	}
+}
+
+static struct idmf_filter_stage * filter_stage_add(idmf_filter *filter,
+		int type, int decimation) {
+	struct idmf_filter_stage *stage;
+
+	if (filter->stages >= IDMF_FILTER_STAGES || decimation <= 0)
+		return 0;
+
+	stage = &filter->stage[filter->stages++];
+	memset(stage, 0, sizeof(*stage));
+	stage->type = type;
+	stage->decimation = decimation;
+
+	return stage;
+}
+
+/**
+ * idmf_filter_add_fir - append a FIR stage
+ * @filter:	the filter
+ * @coeffs:	the coefficients, coeffs[0] weights the newest sample
+ * @taps:	number of coefficients, up to IDMF_FILTER_FIR_MAX
+ * @decimation:	every decimation-th result is passed on, 1 passes all
+ *
+ * Only the results passed on are computed.
+ *
+ * This function returns 0 or -EINVAL.
+ */
+int idmf_filter_add_fir(idmf_filter *filter, const float *coeffs, int taps,
+		int decimation) {
+	struct idmf_filter_stage *stage;
+
+	if (taps <= 0 || taps > IDMF_FILTER_FIR_MAX)
+		return -EINVAL;
+
+	stage = filter_stage_add(filter, IDMF_FILTER_FIR, decimation);
+	if (!stage)
+		return -EINVAL;
+
+	stage->fir.taps = taps;
+	memcpy(stage->fir.coeffs, coeffs, taps * sizeof(*coeffs));
+
+	return 0;
+}
+
+/**
+ * idmf_filter_add_biquad - append a second order IIR stage
+ * @filter:	the filter
+ * @b:		numerator b0, b1, b2
+ * @a:		denominator a1, a2, normalized to a0 = 1
+ * @decimation:	every decimation-th result is passed on, 1 passes all
+ *
+ * Higher orders are built of several biquad stages.
+ *
+ * This function returns 0 or -EINVAL.
+ */
+int idmf_filter_add_biquad(idmf_filter *filter, const float *b, const float *a,
+		int decimation) {
+	struct idmf_filter_stage *stage;
+
+	stage = filter_stage_add(filter, IDMF_FILTER_BIQUAD, decimation);
+	if (!stage)
+		return -EINVAL;
+
+	memcpy(stage->biquad.b, b, sizeof(stage->biquad.b));
+	memcpy(stage->biquad.a, a, sizeof(stage->biquad.a));
+
+	return 0;
+}
+
+/**
+ * idmf_filter_add_cic - append a CIC decimator
+ * @filter:	the filter
+ * @order:	number of integrator and comb sections, up to
+ *		IDMF_FILTER_CIC_MAX
+ * @decimation:	decimation of the stage, at least 2
+ *
+ * The stage averages without multiplications and has unity gain at DC. The
+ * input is rounded to 1 / 2^IDMF_FILTER_CIC_SHIFT, volts and encoder counts
+ * keep their resolution.
+ *
+ * This function returns 0 or -EINVAL.
+ */
+int idmf_filter_add_cic(idmf_filter *filter, int order, int decimation) {
+	struct idmf_filter_stage *stage;
+	double gain;
+	int n;
+
+	if (order <= 0 || order > IDMF_FILTER_CIC_MAX || decimation < 2)
+		return -EINVAL;
+
+	stage = filter_stage_add(filter, IDMF_FILTER_CIC, decimation);
+	if (!stage)
+		return -EINVAL;
+
+	gain = 1.0 / (1 << IDMF_FILTER_CIC_SHIFT);
+	for (n = 0; n < order; n++)
+		gain /= decimation;
+
+	stage->cic.order = order;
+	stage->cic.gain = (float) gain;
+
+	return 0;
+}
+
+/**
+ * idmf_filter_block - filter a block of frames
+ * @filter:	the filter
+ * @in:		@frames frames of IDMF_FILTER_LANES samples each
+ * @out:	the filtered frames, may be the same as @in
+ * @frames:	number of input frames
+ *
+ * The frames are stored one after another, as converted by
+ * idmf_calib_block. The state is kept between the calls, so a stream may be
+ * passed in blocks of any size. @out has to hold @frames frames.
+ *
+ * This function returns the number of filtered frames in @out.
+ */
+size_t idmf_filter_block(idmf_filter *filter, const float *in, float *out,
+		size_t frames) {
+	struct idmf_filter_stage *stage;
+	int i;
+
+	if (!filter->stages) {
+		if (out != in)
+			memmove(out, in, frames * IDMF_FILTER_LANES * sizeof(*out));
+		return frames;
+	}
+
+	/*
+	 * The stages after the first one work in place, the result of a frame
+	 * is never stored behind the frame read next.
+	 */
+	for (i = 0; i < filter->stages; i++) {
+		stage = &filter->stage[i];
+
+		switch (stage->type) {
+		case IDMF_FILTER_FIR:
+			frames = stage_fir(stage, in, out, frames);
+			break;
+		case IDMF_FILTER_BIQUAD:
+			frames = stage_biquad(stage, in, out, frames);
+			break;
+		case IDMF_FILTER_CIC:
+			frames = stage_cic(stage, in, out, frames);
+			break;
+		}
+
+		in = out;
+	}
+
+	return frames;
+}
@@ -0,0 +1,119 @@
+/*
+ * Author Wojciech Domski 2015
+ * www.domski.pl
+ *
+ * Streaming filters and decimation of blocks of ADC or encoder frames.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef __IDMF_FILTER_H
+#define __IDMF_FILTER_H
+
+#include <stddef.h>
+
+#include "idmf_api.h"
+
+/* channels of a frame, all of them are filtered together */
+#define IDMF_FILTER_LANES	8
+
+/* stages of a pipeline */
+#define IDMF_FILTER_STAGES	4
+
+/* taps of a FIR stage */
+#define IDMF_FILTER_FIR_MAX	64
+
+/* order of a CIC stage */
+#define IDMF_FILTER_CIC_MAX	4
+
+/* fraction bits of the fixed point samples of a CIC stage */
+#define IDMF_FILTER_CIC_SHIFT	16
+
+/* type of idmf_filter_stage */
+#define IDMF_FILTER_FIR		0
+#define IDMF_FILTER_BIQUAD	1
+#define IDMF_FILTER_CIC		2
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * idmf_filter_stage - stage of a filter
+ * @type:	IDMF_FILTER_* type
+ * @decimation:	every decimation-th result is passed on
+ * @phase:	inputs since the last result passed on
+ * @fir:	@taps coefficients, newest sample first, and the delay line
+ *		stored twice so that the window never wraps
+ * @biquad:	coefficients normalized to a0 = 1 and the state of the
+ *		transposed direct form II
+ * @cic:	integrators and combs of @order sections, the samples are
+ *		fixed point with IDMF_FILTER_CIC_SHIFT fraction bits and the
+ *		result is scaled by @gain to unity gain at DC
+ */
+struct idmf_filter_stage {
+	int type;
+	int decimation;
+	int phase;
+
+	struct {
+		int taps;
+		int pos;
+		float coeffs[IDMF_FILTER_FIR_MAX];
+		float history[2 * IDMF_FILTER_FIR_MAX][IDMF_FILTER_LANES];
+	} fir;
+
+	struct {
+		float b[3];
+		float a[2];
+		float z1[IDMF_FILTER_LANES];
+		float z2[IDMF_FILTER_LANES];
+	} biquad;
+
+	struct {
+		int order;
+		float gain;
+		__u64 integ[IDMF_FILTER_CIC_MAX][IDMF_FILTER_LANES];
+		__u64 comb[IDMF_FILTER_CIC_MAX][IDMF_FILTER_LANES];
+	} cic;
+};
+
+/**
+ * idmf_filter - pipeline of filter stages
+ * @stages:	number of stages
+ * @stage:	the stages in the order the samples pass them
+ */
+typedef struct {
+	int stages;
+	struct idmf_filter_stage stage[IDMF_FILTER_STAGES];
+} idmf_filter;
+
+void idmf_filter_init(idmf_filter *filter);
+void idmf_filter_reset(idmf_filter *filter);
+
+int idmf_filter_add_fir(idmf_filter *filter, const float *coeffs, int taps,
+		int decimation);
+int idmf_filter_add_biquad(idmf_filter *filter, const float *b, const float *a,
+		int decimation);
+int idmf_filter_add_cic(idmf_filter *filter, int order, int decimation);
+
+size_t idmf_filter_block(idmf_filter *filter, const float *in, float *out,
+		size_t frames);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
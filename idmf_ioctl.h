@@ -0,0 +1,692 @@
+/*
+ * Copyright (C) 2015 Wojciech Domski <Wojciech.Domski@gmail.com>
+ *
+ * Interface shared by the RTDM driver for the
+ * Mecovis IntelliDAQ Multi-Function Series and its user-space API.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef __IDMF_IOCTL_H
+#define __IDMF_IOCTL_H
+
+#include <linux/types.h>
+#include <linux/ioctl.h>
+
+#define NUM_DACS		 8
+#define NUM_ADCS		 8
+#define NUM_PORTS		 3
+#define NUM_PORT_CHANNELS	 8
+#define NUM_ENCS		 8
+#define NUM_GPIOS		24
+
+#define DAC_CONF	0x0000
+#define DAC_VALUE	0x0020
+#define PRT_VALUE	0x0080
+#define PRT_CTRL	0x008C
+#define ENC_PWRCTRL	0x0090
+#define GPIO_DIR0	0x0094
+#define GPIO_DIR1	0x0098
+#define ENC_ALARM0	0x009C
+#define ENC_ALARM1	0x00A0
+#define ENC_PWRSTAT	0x00A4
+#define ADC_DATA	0x00A8
+#define ADC_REF		0x00AC
+#define BCT_LED		0x0200
+#define BCT_PWR		0x0204
+#define BCT_ADC		0x0208
+#define GPIO_IN		0x0210
+#define GPIO_OUT	0x0214
+#define MFC_CCR		0x0300
+#define MFC_CSR		0x0304
+#define MFC_CNT		0x0308
+#define MFC_PLV		0x030C
+#define MFC_DCR		0x0318
+
+#define REG_WRITE	0x10000000
+#define REG_READ	0x20000000
+
+/* size of the register window mapped from BAR0 */
+#define IDMF_REG_WINDOW		0x1000
+
+/*
+ * Plain register access is encoded directly in the ioctl request as
+ * REG_WRITE/REG_READ | offset. All other requests use the type below,
+ * which lies outside of the register window and therefore can not be
+ * mistaken for a register offset.
+ */
+#define IDMF_RTIOC_TYPE		'I'
+
+/* register operations of a transaction */
+#define IDMF_OP_READ		0x01
+#define IDMF_OP_WRITE		0x02
+
+/* maximum number of operations executed by a single transaction */
+#define IDMF_XACT_MAX		64
+
+/**
+ * idmf_reg_op - single register operation
+ * @op:		IDMF_OP_READ or IDMF_OP_WRITE
+ * @offset:	register offset within the register window
+ * @value:	value to be written, or the value read back by the driver
+ */
+struct idmf_reg_op {
+	__u32 op;
+	__u32 offset;
+	__u32 value;
+};
+
+/**
+ * idmf_xact - batch of register operations
+ * @count:	number of operations, at most IDMF_XACT_MAX
+ * @ops:	user pointer to an array of struct idmf_reg_op
+ *
+ * The operations are executed in order within one kernel entry. Values of
+ * read operations are written back to the array.
+ */
+struct idmf_xact {
+	__u32 count;
+	__u32 reserved;
+	__u64 ops;
+};
+
+/**
+ * idmf_adc_frame - result of an ADC conversion
+ * @timestamp:	rtdm_clock_read at the start of the conversion
+ * @value:	the samples in channel order
+ */
+struct idmf_adc_frame {
+	__u64 timestamp;
+	__s16 value[NUM_ADCS];
+};
+
+/**
+ * idmf_mmap - mapping of a driver area into the caller's address space
+ * @addr:	start address of the mapping
+ * @size:	size of the mapping in bytes
+ *
+ * The mapping is released with munmap.
+ */
+struct idmf_mmap {
+	__u64 addr;
+	__u64 size;
+};
+
+/* sources of struct idmf_acq_config and struct idmf_sample flags */
+#define IDMF_ACQ_ADC		0x0001
+#define IDMF_ACQ_GPIO		0x0002
+
+/* limits of the periodic acquisition */
+#define IDMF_ACQ_MIN_PERIOD	10000
+#define IDMF_ACQ_MAX_FRAMES	65536
+#define IDMF_ACQ_MAX_OVERSAMPLE	256
+
+/**
+ * idmf_acq_config - configuration of the periodic acquisition
+ * @period_ns:	sampling period in nanoseconds
+ * @timeout:	timeout of read in nanoseconds, 0 waits infinitely and a
+ *		negative value does not wait at all
+ * @frames:	number of samples held by the ring, a power of two
+ * @flags:	IDMF_ACQ_ADC and IDMF_ACQ_GPIO
+ * @enc_mask:	encoder channels to be sampled
+ * @port_mask:	ports to be sampled
+ * @priority:	priority of the acquisition task, 0 selects the default
+ * @oversample:	ADC conversions per period, 0 and 1 convert once; the
+ *		samples hold their mean and all conversions are added to the
+ *		accumulators read by IDMF_RTIOC_ADC_ACCUM
+ */
+struct idmf_acq_config {
+	__u64 period_ns;
+	__s64 timeout;
+	__u32 frames;
+	__u32 flags;
+	__u32 enc_mask;
+	__u32 port_mask;
+	__s32 priority;
+	__u32 oversample;
+};
+
+/**
+ * idmf_acq_status - state of the periodic acquisition
+ * @running:	non-zero while the acquisition task is running
+ * @frames:	number of samples held by the ring
+ * @available:	number of samples ready to be read
+ * @overruns:	number of samples dropped because the ring was full
+ * @samples:	number of samples taken since the start
+ */
+struct idmf_acq_status {
+	__u32 running;
+	__u32 frames;
+	__u32 available;
+	__u32 overruns;
+	__u64 samples;
+};
+
+/**
+ * idmf_sample - record of the periodic acquisition, returned by read
+ * @timestamp:	rtdm_clock_read at the start of the sample
+ * @seq:	sequence number of the sample
+ * @flags:	IDMF_ACQ_* sources present in the sample, IDMF_ACQ_ADC is
+ *		missing when an asynchronous conversion was in progress
+ * @enc_mask:	encoder channels present in the sample
+ * @port_mask:	ports present in the sample
+ * @adc:	ADC samples in channel order
+ * @enc:	encoder counts
+ * @port:	port values
+ * @gpio:	GPIO_IN
+ * @enc_pos:	unwrapped encoder positions, see struct idmf_enc_track
+ * @enc_vel:	encoder velocities in counts per second
+ */
+struct idmf_sample {
+	__u64 timestamp;
+	__u32 seq;
+	__u32 flags;
+	__u32 enc_mask;
+	__u32 port_mask;
+	__s16 adc[NUM_ADCS];
+	__s32 enc[NUM_ENCS];
+	__u8 port[NUM_PORTS];
+	__u8 reserved;
+	__u32 gpio;
+	__s64 enc_pos[NUM_ENCS];
+	__s32 enc_vel[NUM_ENCS];
+};
+
+/**
+ * idmf_ring - header of the sample ring shared with user space
+ * @head:	index of the next sample written by the driver
+ * @tail:	index of the next sample to be consumed
+ * @frames:	number of samples held by the ring, a power of two
+ * @frame_size:	size of a sample, sizeof(struct idmf_sample)
+ * @data_offset: offset of the first sample from the start of the header
+ * @overruns:	number of samples dropped because the ring was full
+ *
+ * The indices run freely, sample i is stored in slot i & (frames - 1).
+ * Samples between tail and head are valid once head has been read with
+ * acquire semantics; the consumer releases them by storing the new tail
+ * with release semantics. @head and @tail live in separate cache lines.
+ */
+struct idmf_ring {
+	__u32 head;
+	__u32 reserved0[15];
+	__u32 tail;
+	__u32 reserved1[15];
+	__u32 frames;
+	__u32 frame_size;
+	__u32 data_offset;
+	__u32 overruns;
+};
+
+/* idmf_irq_event flags */
+#define IDMF_IRQ_CLEAR		0x0001	/* discard events before waiting */
+
+/**
+ * idmf_irq_event - interrupt wait request and result
+ * @timeout:	timeout in nanoseconds, 0 waits infinitely and a negative
+ *		value does not wait at all
+ * @flags:	IDMF_IRQ_CLEAR
+ * @sources:	interrupt sources since the last wait, bit n denotes an event
+ *		of counter channel n
+ * @count:	number of interrupts handled since the driver was loaded
+ * @timestamp:	rtdm_clock_read when the last interrupt was handled
+ */
+struct idmf_irq_event {
+	__s64 timeout;
+	__u32 flags;
+	__u32 sources;
+	__u32 count;
+	__u32 reserved;
+	__u64 timestamp;
+};
+
+/**
+ * idmf_snapshot - all inputs of a board taken in one driver call
+ * @timestamp:	rtdm_clock_read at the start of the snapshot
+ * @adc:	ADC samples in channel order
+ * @enc:	encoder counts, MFC_CNT of each channel
+ * @port:	port values, PRT_VALUE
+ * @gpio:	GPIO_IN
+ * @enc_alarm:	ENC_ALARM0 and ENC_ALARM1
+ * @enc_pwrstat: ENC_PWRSTAT
+ */
+struct idmf_snapshot {
+	__u64 timestamp;
+	__s16 adc[NUM_ADCS];
+	__s32 enc[NUM_ENCS];
+	__u8 port[NUM_PORTS];
+	__u8 reserved;
+	__u32 gpio;
+	__u32 enc_alarm[2];
+	__u32 enc_pwrstat;
+};
+
+/* idmf_out_frame flags */
+#define IDMF_OUT_GPIO		0x0001	/* write @gpio to GPIO_OUT */
+#define IDMF_OUT_LED		0x0002	/* write @led to BCT_LED */
+#define IDMF_OUT_FORCE		0x0100	/* write unchanged values as well */
+
+/**
+ * idmf_out_frame - outputs of a board written in one driver call
+ * @flags:	IDMF_OUT_* flags
+ * @dac_mask:	DAC channels to be written
+ * @port_mask:	ports to be written
+ * @dac:	DAC values, latched together through DAC_CONF
+ * @port:	port values, PRT_VALUE
+ * @gpio:	GPIO_OUT
+ * @led:	BCT_LED
+ *
+ * Values equal to the ones of the previous commit are not written again,
+ * unless IDMF_OUT_FORCE is given. DAC_CONF is only written when a DAC value
+ * changed.
+ */
+struct idmf_out_frame {
+	__u32 flags;
+	__u32 dac_mask;
+	__u32 port_mask;
+	__u32 reserved0;
+	__s16 dac[NUM_DACS];
+	__u8 port[NUM_PORTS];
+	__u8 reserved1;
+	__u32 gpio;
+	__u32 led;
+};
+
+/* idmf_adc_ref flags */
+#define IDMF_REF_FORCE		0x0001	/* program unchanged values as well */
+
+/**
+ * idmf_adc_ref - references of the ADC
+ * @refadc:	reference voltage of ADC (5.0 V / 65535)
+ * @refina:	reference voltage of INA (5.0 V / 65535)
+ * @flags:	IDMF_REF_FORCE
+ */
+struct idmf_adc_ref {
+	__u16 refadc;
+	__u16 refina;
+	__u32 flags;
+};
+
+/* number of entries held by the trace ring, a power of two */
+#define IDMF_TRACE_FRAMES	4096
+
+/* idmf_trace_ctl flags */
+#define IDMF_TRACE_ENABLE	0x0001
+
+/**
+ * idmf_trace_ctl - control of the register access trace
+ * @flags:	IDMF_TRACE_ENABLE turns tracing on, its absence off
+ * @head:	returns the sequence number of the next entry
+ */
+struct idmf_trace_ctl {
+	__u32 flags;
+	__u32 head;
+};
+
+/**
+ * idmf_trace_entry - register access issued by the driver
+ * @timestamp:	rtdm_clock_read before the access
+ * @seq:	sequence number of the entry
+ * @op:		IDMF_OP_READ or IDMF_OP_WRITE
+ * @offset:	register offset
+ * @value:	value read or written
+ * @duration:	duration of the access in ns
+ */
+struct idmf_trace_entry {
+	__u64 timestamp;
+	__u32 seq;
+	__u16 op;
+	__u16 offset;
+	__u32 value;
+	__u32 duration;
+};
+
+/**
+ * idmf_trace_dump - copy of trace entries
+ * @entries:	user pointer to an array of struct idmf_trace_entry
+ * @count:	capacity of @entries, returns the number of entries copied
+ * @start:	sequence number of the first entry wanted, returns the sequence
+ *		number to start the next dump with
+ * @lost:	returns the number of entries overwritten before being copied
+ *
+ * Entries are copied in order up to the first one still being written.
+ */
+struct idmf_trace_dump {
+	__u64 entries;
+	__u32 count;
+	__u32 start;
+	__u32 lost;
+	__u32 reserved;
+};
+
+/* maximum number of boards of a group snapshot */
+#define IDMF_GROUP_MAX		6
+
+/**
+ * idmf_group_frame - inputs of all boards taken in one driver call
+ * @timestamp:	rtdm_clock_read when the ADC conversions were triggered
+ * @boards:	number of boards in @board
+ * @board:	snapshot of board idmfN at index N
+ *
+ * The ADC conversions of all boards are started back to back. The other
+ * inputs of all boards are read while the conversions are running, so the
+ * timestamps of the board snapshots are equal to @timestamp.
+ */
+struct idmf_group_frame {
+	__u64 timestamp;
+	__u32 boards;
+	__u32 reserved;
+	struct idmf_snapshot board[IDMF_GROUP_MAX];
+};
+
+/* flags of struct idmf_adc_accum */
+#define IDMF_ACCUM_RESET	0x0001
+
+/**
+ * idmf_adc_accum - ADC conversions accumulated by the acquisition
+ * @flags:	IDMF_ACCUM_RESET clears the accumulators once they are read
+ * @count:	number of conversions accumulated
+ * @first:	rtdm_clock_read of the first conversion
+ * @last:	rtdm_clock_read of the last conversion
+ * @sum:	sum of the samples of each channel
+ * @min:	smallest sample of each channel
+ * @max:	largest sample of each channel
+ *
+ * The accumulators are cleared when the acquisition starts. @min and @max
+ * are not valid while @count is 0.
+ */
+struct idmf_adc_accum {
+	__u32 flags;
+	__u32 count;
+	__u64 first;
+	__u64 last;
+	__s64 sum[NUM_ADCS];
+	__s16 min[NUM_ADCS];
+	__s16 max[NUM_ADCS];
+};
+
+/* flags of struct idmf_enc_track */
+#define IDMF_ENC_TRACK_CONFIG	0x0001	/* set the window and restart */
+
+/* default velocity window of the encoder tracking */
+#define IDMF_ENC_WINDOW_NS	10000000
+
+/**
+ * idmf_enc_track - state of the encoder tracking
+ * @flags:	IDMF_ENC_TRACK_CONFIG applies @window_ns
+ * @window_ns:	velocity window in nanoseconds, 0 selects IDMF_ENC_WINDOW_NS
+ * @timestamp:	rtdm_clock_read of the last reading of each channel, 0 if
+ *		the channel has not been read yet
+ * @position:	unwrapped position of each channel
+ * @velocity:	velocity of each channel in counts per second
+ *
+ * The driver extends MFC_CNT to 64 bits each time it reads the counter for
+ * the acquisition or a snapshot. The counter has to be read at least once
+ * per 2^31 counts. The velocity is the change of the position over the
+ * readings within the last @window_ns, or over the last two readings when
+ * they are further apart. A write of MFC_CNT through the driver restarts
+ * the channel at the written count.
+ */
+struct idmf_enc_track {
+	__u32 flags;
+	__u32 reserved;
+	__u64 window_ns;
+	__u64 timestamp[NUM_ENCS];
+	__s64 position[NUM_ENCS];
+	__s32 velocity[NUM_ENCS];
+};
+
+/* flags of struct idmf_mon_config */
+#define IDMF_MON_IRQ		0x0001	/* sample on every counter interrupt */
+
+/* sources of struct idmf_mon_event */
+#define IDMF_MON_GPIO		0
+#define IDMF_MON_PORT(n)	(1 + (n))
+
+/* limits of the edge monitor */
+#define IDMF_MON_MIN_PERIOD	10000
+#define IDMF_MON_EVENTS		4096
+
+/**
+ * idmf_mon_config - configuration of the edge monitor
+ * @period_ns:	sampling period in nanoseconds, 0 samples on interrupts only
+ * @flags:	IDMF_MON_IRQ, requires the driver to be loaded with use_irq=1
+ * @gpio_mask:	GPIO_IN pins to be monitored
+ * @port_mask:	port pins to be monitored, bit 8 * n + c is channel c of
+ *		port n
+ * @priority:	priority of the monitor task, 0 selects the default
+ *
+ * The board interrupts only on counter events reported in MFC_CSR, GPIO and
+ * port edges do not raise it. IDMF_MON_IRQ therefore samples the pins when
+ * a counter event occurs, e.g. to catch a limit switch together with an
+ * index pulse; edges between counter events are only found by the periodic
+ * samples of @period_ns.
+ */
+struct idmf_mon_config {
+	__u64 period_ns;
+	__u32 flags;
+	__u32 gpio_mask;
+	__u32 port_mask;
+	__s32 priority;
+};
+
+/**
+ * idmf_mon_event - edges of a source found by a sample of the monitor
+ * @timestamp:	rtdm_clock_read of the sample
+ * @source:	IDMF_MON_GPIO or IDMF_MON_PORT(n)
+ * @value:	value of the source at the sample
+ * @rising:	monitored pins which went from 0 to 1
+ * @falling:	monitored pins which went from 1 to 0
+ *
+ * A pin which toggled twice between two samples is not reported.
+ */
+struct idmf_mon_event {
+	__u64 timestamp;
+	__u32 source;
+	__u32 value;
+	__u32 rising;
+	__u32 falling;
+};
+
+/**
+ * idmf_mon_read - request for the events of the edge monitor
+ * @events:	user pointer to the buffer of struct idmf_mon_event
+ * @timeout:	timeout in nanoseconds, 0 waits infinitely and a negative
+ *		value does not wait at all
+ * @count:	capacity of @events, set to the number of events returned
+ * @lost:	set to the number of events dropped on a full queue since the
+ *		previous read
+ *
+ * The request waits until at least one event is queued, the monitor stops
+ * or the timeout expires.
+ */
+struct idmf_mon_read {
+	__u64 events;
+	__s64 timeout;
+	__u32 count;
+	__u32 lost;
+};
+
+/* targets of struct idmf_bit_op */
+#define IDMF_BITS_PORT(n)	(n)
+#define IDMF_BITS_GPIO		NUM_PORTS
+
+/**
+ * idmf_bit_op - atomic update of output bits
+ * @target:	IDMF_BITS_PORT(n) for PRT_VALUE of port n or IDMF_BITS_GPIO for
+ *		GPIO_OUT
+ * @set:	bits to be set
+ * @clear:	bits to be cleared
+ * @toggle:	bits to be inverted, applied after @set and @clear
+ * @value:	set to the resulting value of the register
+ * @reserved:	must be 0
+ *
+ * The driver applies the masks to the value it last wrote, under a lock
+ * shared with IDMF_RTIOC_OUT_COMMIT, so processes driving different bits of
+ * a register do not overwrite each other. The register is read back when
+ * the driver has not written it yet and whenever the register window is
+ * mapped by IDMF_RTIOC_MMAP_REGS, since stores through the window bypass
+ * the driver.
+ */
+struct idmf_bit_op {
+	__u32 target;
+	__u32 set;
+	__u32 clear;
+	__u32 toggle;
+	__u32 value;
+	__u32 reserved;
+};
+
+/**
+ * idmf_claim - resources owned by an open file of a board
+ * @dac_mask:	DAC channels
+ * @enc_mask:	encoder channels, their MFC_* registers
+ * @gpio_mask:	GPIO_OUT pins and their directions
+ * @port_mask:	PRT_VALUE pins of each port and their directions
+ * @reserved:	must be 0
+ *
+ * Resources claimed by an open file can only be written through it, writes
+ * through other open files fail with -EACCES. Unclaimed resources can be
+ * written by everyone. A register holding pins of several owners, GPIO_OUT
+ * or PRT_VALUE, can then only be changed by IDMF_RTIOC_BIT_OP. The direction
+ * registers PRT_CTRL and GPIO_DIR0/1 hold all ports or all pins, so they
+ * cannot be written by other files while any of them is claimed. Claims are
+ * released when the file is closed. Reads are not checked. Writes through
+ * the register window mapped by IDMF_RTIOC_MMAP_REGS cannot be checked, so
+ * claims and the mapped window exclude each other: claiming fails with
+ * -EBUSY while the window is mapped and mapping fails with -EBUSY while any
+ * resource is claimed.
+ */
+struct idmf_claim {
+	__u32 dac_mask;
+	__u32 enc_mask;
+	__u32 gpio_mask;
+	__u8 port_mask[NUM_PORTS];
+	__u8 reserved;
+};
+
+/**
+ * idmf_adc_wait - completion of an asynchronous ADC conversion
+ * @timeout:	timeout in nanoseconds, 0 waits infinitely and a negative
+ *		value does not wait at all
+ * @seq:	set to the sequence number of the conversion in @frame
+ * @reserved:	must be 0
+ * @frame:	set to the samples of the last completed conversion
+ *
+ * IDMF_RTIOC_ADC_SUBMIT starts a conversion and returns its sequence
+ * number. IDMF_RTIOC_ADC_WAIT waits for the conversion last submitted
+ * through the same open file. A conversion submitted by another file later
+ * may have completed in the meantime, @seq tells which one @frame holds.
+ */
+struct idmf_adc_wait {
+	__s64 timeout;
+	__u32 seq;
+	__u32 reserved;
+	struct idmf_adc_frame frame;
+};
+
+/* operations of struct idmf_prog_op */
+#define IDMF_PROG_READ		0x01	/* read @offset, e.g. to flush writes */
+#define IDMF_PROG_READ_OUT	0x02	/* read @offset into output @slot */
+#define IDMF_PROG_WRITE		0x03	/* write @value to @offset */
+#define IDMF_PROG_WRITE_IN	0x04	/* write input @slot to @offset */
+#define IDMF_PROG_DELAY		0x05	/* busy wait for @value nanoseconds */
+
+/* limits of register programs */
+#define IDMF_PROG_MAX		8	/* programs loaded per open file */
+#define IDMF_PROG_MAX_OPS	256	/* operations of a program */
+#define IDMF_PROG_SLOTS		32	/* input and output slots */
+#define IDMF_PROG_MAX_DELAY	100000	/* sum of the delays in nanoseconds */
+
+/**
+ * idmf_prog_op - operation of a register program
+ * @op:		IDMF_PROG_* operation
+ * @slot:	input or output slot of IDMF_PROG_WRITE_IN and
+ *		IDMF_PROG_READ_OUT, below IDMF_PROG_SLOTS
+ * @offset:	register offset within the register window
+ * @value:	value of IDMF_PROG_WRITE, nanoseconds of IDMF_PROG_DELAY
+ */
+struct idmf_prog_op {
+	__u16 op;
+	__u16 slot;
+	__u32 offset;
+	__u32 value;
+};
+
+/**
+ * idmf_prog_load - upload of a register program
+ * @ops:	user pointer to an array of struct idmf_prog_op
+ * @count:	number of operations, at most IDMF_PROG_MAX_OPS
+ * @handle:	set to the handle of the program
+ *
+ * The program is validated once when it is loaded and belongs to the open
+ * file it was loaded through. It is removed by IDMF_RTIOC_PROG_UNLOAD with
+ * its handle or when the file is closed.
+ */
+struct idmf_prog_load {
+	__u64 ops;
+	__u32 count;
+	__u32 handle;
+};
+
+/**
+ * idmf_prog_run - execution of a register program
+ * @handle:	handle returned by IDMF_RTIOC_PROG_LOAD
+ * @reserved:	must be 0
+ * @timestamp:	set to rtdm_clock_read at the start of the program
+ * @in:		values of the input slots
+ * @out:	set to the values of the output slots
+ *
+ * Only the slots used by the program are copied between the driver and
+ * user space. The writes are checked against the claims of other open
+ * files before the first operation.
+ */
+struct idmf_prog_run {
+	__u32 handle;
+	__u32 reserved;
+	__u64 timestamp;
+	__u32 in[IDMF_PROG_SLOTS];
+	__u32 out[IDMF_PROG_SLOTS];
+};
+
+#define IDMF_RTIOC_XACT		_IOWR(IDMF_RTIOC_TYPE, 0x00, struct idmf_xact)
+#define IDMF_RTIOC_ADC_CONVERT	_IOR(IDMF_RTIOC_TYPE, 0x01, struct idmf_adc_frame)
+#define IDMF_RTIOC_MMAP_REGS	_IOR(IDMF_RTIOC_TYPE, 0x02, struct idmf_mmap)
+#define IDMF_RTIOC_ACQ_START	_IOW(IDMF_RTIOC_TYPE, 0x03, struct idmf_acq_config)
+#define IDMF_RTIOC_ACQ_STOP	_IO(IDMF_RTIOC_TYPE, 0x04)
+#define IDMF_RTIOC_ACQ_STATUS	_IOR(IDMF_RTIOC_TYPE, 0x05, struct idmf_acq_status)
+#define IDMF_RTIOC_ACQ_MMAP	_IOR(IDMF_RTIOC_TYPE, 0x06, struct idmf_mmap)
+#define IDMF_RTIOC_ACQ_WAIT	_IOW(IDMF_RTIOC_TYPE, 0x07, __u32)
+#define IDMF_RTIOC_IRQ_WAIT	_IOWR(IDMF_RTIOC_TYPE, 0x08, struct idmf_irq_event)
+#define IDMF_RTIOC_SNAPSHOT	_IOR(IDMF_RTIOC_TYPE, 0x09, struct idmf_snapshot)
+#define IDMF_RTIOC_OUT_COMMIT	_IOW(IDMF_RTIOC_TYPE, 0x0A, struct idmf_out_frame)
+#define IDMF_RTIOC_ADC_REF	_IOW(IDMF_RTIOC_TYPE, 0x0B, struct idmf_adc_ref)
+#define IDMF_RTIOC_TRACE_CTL	_IOWR(IDMF_RTIOC_TYPE, 0x0C, struct idmf_trace_ctl)
+#define IDMF_RTIOC_TRACE_DUMP	_IOWR(IDMF_RTIOC_TYPE, 0x0D, struct idmf_trace_dump)
+#define IDMF_RTIOC_GROUP_SNAPSHOT _IOR(IDMF_RTIOC_TYPE, 0x0E, struct idmf_group_frame)
+#define IDMF_RTIOC_ADC_ACCUM	_IOWR(IDMF_RTIOC_TYPE, 0x0F, struct idmf_adc_accum)
+#define IDMF_RTIOC_ENC_TRACK	_IOWR(IDMF_RTIOC_TYPE, 0x10, struct idmf_enc_track)
+#define IDMF_RTIOC_MON_START	_IOW(IDMF_RTIOC_TYPE, 0x11, struct idmf_mon_config)
+#define IDMF_RTIOC_MON_STOP	_IO(IDMF_RTIOC_TYPE, 0x12)
+#define IDMF_RTIOC_MON_READ	_IOWR(IDMF_RTIOC_TYPE, 0x13, struct idmf_mon_read)
+#define IDMF_RTIOC_BIT_OP	_IOWR(IDMF_RTIOC_TYPE, 0x14, struct idmf_bit_op)
+#define IDMF_RTIOC_CLAIM	_IOWR(IDMF_RTIOC_TYPE, 0x15, struct idmf_claim)
+#define IDMF_RTIOC_RELEASE	_IOWR(IDMF_RTIOC_TYPE, 0x16, struct idmf_claim)
+#define IDMF_RTIOC_ADC_SUBMIT	_IOR(IDMF_RTIOC_TYPE, 0x17, __u32)
+#define IDMF_RTIOC_ADC_WAIT	_IOWR(IDMF_RTIOC_TYPE, 0x18, struct idmf_adc_wait)
+#define IDMF_RTIOC_PROG_LOAD	_IOWR(IDMF_RTIOC_TYPE, 0x19, struct idmf_prog_load)
+#define IDMF_RTIOC_PROG_UNLOAD	_IOW(IDMF_RTIOC_TYPE, 0x1A, __u32)
+#define IDMF_RTIOC_PROG_RUN	_IOWR(IDMF_RTIOC_TYPE, 0x1B, struct idmf_prog_run)
+
+#endif /* __IDMF_IOCTL_H */
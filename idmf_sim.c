@@ -0,0 +1,811 @@
+/*
+ * Author Wojciech Domski 2015
+ * www.domski.pl
+ *
+ * Software model of the IDMF board used as an in-process transport of the
+ * API.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#include "idmf_sim.h"
+
+/* ADC_REF serial interface lines */
+#define SIM_REF_CLK	0x01
+#define SIM_REF_LOAD	0x02
+#define SIM_REF_DATA	0x04
+
+/* PRT_CTRL bits which configure a port as an input */
+static const __u32 sim_port_input[NUM_PORTS] = { 0x09, 0x10, 0x02 };
+
+/* order in which the board delivers the ADC channels through ADC_DATA */
+static const int sim_adc_order[NUM_ADCS] = { 5, 4, 1, 0, 3, 2, 7, 6 };
+
+/**
+ * idmf_sim - state of a simulated board
+ * @regs:	plain register file
+ * @dac_out:	DAC outputs latched by DAC_CONF
+ * @adc_in:	analog inputs, used when the channel is set in @adc_forced
+ * @adc_fifo:	converted samples in the order of ADC_DATA
+ * @enc_cnt:	encoder counters
+ * @port_in:	signals driving the ports configured as inputs
+ * @gpio_in:	signals driving the GPIO pins configured as inputs
+ * @ref_shift:	ADC_REF shift register
+ * @claim:	resources claimed, a simulated board has no other users
+ * @adc_seq:	sequence number of the last asynchronous conversion
+ * @adc_frame:	samples of the last asynchronous conversion
+ * @prog:	register programs by handle - 1
+ * @prog_count:	number of operations of the programs
+ */
+struct idmf_sim {
+	__u32 regs[IDMF_REG_WINDOW / 4];
+
+	__s16 dac_out[NUM_DACS];
+
+	__s16 adc_in[NUM_ADCS];
+	__u32 adc_forced;
+	__s16 adc_fifo[NUM_ADCS];
+	int adc_fifo_pos;
+
+	__u32 enc_cnt[NUM_ENCS];
+
+	__u8 port_in[NUM_PORTS];
+	__u32 gpio_in;
+
+	__u32 ref_shift;
+	__u16 refadc;
+	__u16 refina;
+
+	struct idmf_claim claim;
+
+	__u32 adc_seq;
+	struct idmf_adc_frame adc_frame;
+
+	struct idmf_prog_op *prog[IDMF_PROG_MAX];
+	__u32 prog_count[IDMF_PROG_MAX];
+
+	__u32 call_ns;
+	__u32 access_ns;
+
+	__u64 calls;
+	__u64 accesses;
+};
+
+static inline struct idmf_sim *sim_of(idmf_board *board) {
+	return (struct idmf_sim *) board->priv;
+}
+
+static __u64 sim_clock(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (__u64) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void sim_delay(__u32 ns) {
+	__u64 end;
+
+	if (!ns)
+		return;
+
+	end = sim_clock() + ns;
+
+	while (sim_clock() < end)
+		;
+}
+
+static inline void sim_call(struct idmf_sim *sim) {
+	sim->calls++;
+	sim_delay(sim->call_ns);
+}
+
+/* encoder channel of a MFC_CNT register or -1 */
+static int sim_enc_channel(__u32 address) {
+	if (address < MFC_CNT || address >= MFC_CNT + NUM_ENCS * 0x40)
+		return -1;
+
+	if ((address - MFC_CNT) % 0x40)
+		return -1;
+
+	return (address - MFC_CNT) / 0x40;
+}
+
+static void sim_convert(struct idmf_sim *sim) {
+	int i;
+	int channel;
+
+	/* without a forced input the channel samples its own DAC output */
+	for (i = 0; i < NUM_ADCS; i++) {
+		channel = sim_adc_order[i];
+
+		if (sim->adc_forced & (1 << channel))
+			sim->adc_fifo[i] = sim->adc_in[channel];
+		else
+			sim->adc_fifo[i] = sim->dac_out[channel];
+	}
+
+	sim->adc_fifo_pos = 0;
+}
+
+static void sim_ref_write(struct idmf_sim *sim, __u32 value) {
+	__u32 previous = sim->regs[ADC_REF >> 2];
+
+	if ((value & SIM_REF_CLK) && !(previous & SIM_REF_CLK))
+		sim->ref_shift = (sim->ref_shift << 1)
+				| ((value & SIM_REF_DATA) ? 1 : 0);
+
+	if ((value & SIM_REF_LOAD) && !(previous & SIM_REF_LOAD)) {
+		switch ((sim->ref_shift >> 16) & 0xFF) {
+		case 0x10:
+			sim->refina = (__u16) sim->ref_shift;
+			break;
+		case 0x24:
+			sim->refadc = (__u16) sim->ref_shift;
+			break;
+		}
+
+		sim->ref_shift = 0;
+	}
+}
+
+static __u32 sim_read(struct idmf_sim *sim, __u32 address) {
+	__u32 dirs;
+	int port;
+	int channel;
+
+	sim->accesses++;
+	sim_delay(sim->access_ns);
+
+	channel = sim_enc_channel(address);
+	if (channel >= 0)
+		return sim->enc_cnt[channel];
+
+	if (address >= PRT_VALUE && address < PRT_VALUE + NUM_PORTS * 0x04) {
+		port = (address - PRT_VALUE) / 0x04;
+
+		if (sim->regs[PRT_CTRL >> 2] & sim_port_input[port])
+			return sim->port_in[port];
+
+		return sim->regs[address >> 2] & 0xFF;
+	}
+
+	switch (address) {
+	case ADC_DATA:
+		if (sim->adc_fifo_pos >= NUM_ADCS)
+			return 0;
+
+		return (__u32) (__u16) sim->adc_fifo[sim->adc_fifo_pos++];
+	case GPIO_IN:
+		dirs = sim->regs[GPIO_DIR0 >> 2];
+
+		return ((sim->regs[GPIO_OUT >> 2] & dirs) | (sim->gpio_in & ~dirs))
+				& ((1 << NUM_GPIOS) - 1);
+	}
+
+	return sim->regs[address >> 2];
+}
+
+static void sim_write(struct idmf_sim *sim, __u32 address, __u32 value) {
+	int i;
+	int channel;
+
+	sim->accesses++;
+	sim_delay(sim->access_ns);
+
+	channel = sim_enc_channel(address);
+	if (channel >= 0) {
+		sim->enc_cnt[channel] = value;
+		return;
+	}
+
+	switch (address) {
+	case DAC_CONF:
+		if ((value & 0x0000C000) == 0x0000C000)
+			for (i = 0; i < NUM_DACS; i++)
+				sim->dac_out[i] = (__s16) sim->regs[(DAC_VALUE >> 2) + i];
+		break;
+	case BCT_ADC:
+		/* the conversion starts on the falling edge of the request */
+		if ((sim->regs[BCT_ADC >> 2] & 0x01) && !(value & 0x01))
+			sim_convert(sim);
+		break;
+	case ADC_REF:
+		sim_ref_write(sim, value);
+		break;
+	}
+
+	sim->regs[address >> 2] = value;
+}
+
+static int sim_open(idmf_board *board) {
+	struct idmf_sim *sim;
+	const char *env;
+
+	sim = calloc(1, sizeof(*sim));
+	if (!sim)
+		return -ENOMEM;
+
+	sim->regs[PRT_CTRL >> 2] = 0x9B;
+	sim->adc_fifo_pos = NUM_ADCS;
+
+	sim->call_ns = IDMF_SIM_CALL_NS;
+	sim->access_ns = IDMF_SIM_ACCESS_NS;
+
+	env = getenv("IDMF_SIM_CALL_NS");
+	if (env)
+		sim->call_ns = strtoul(env, 0, 0);
+
+	env = getenv("IDMF_SIM_ACCESS_NS");
+	if (env)
+		sim->access_ns = strtoul(env, 0, 0);
+
+	board->priv = sim;
+
+	return 0;
+}
+
+static int sim_close(idmf_board *board) {
+	struct idmf_sim *sim = sim_of(board);
+	int i;
+
+	for (i = 0; i < IDMF_PROG_MAX; i++)
+		free(sim->prog[i]);
+
+	free(board->priv);
+	board->priv = 0;
+
+	return 0;
+}
+
+static __u32 sim_reg_read(idmf_board *board, __u32 address) {
+	struct idmf_sim *sim = sim_of(board);
+
+	sim_call(sim);
+
+	if ((address & 0x03) || address >= IDMF_REG_WINDOW)
+		return 0;
+
+	return sim_read(sim, address);
+}
+
+static int sim_reg_write(idmf_board *board, __u32 address, __u32 value) {
+	struct idmf_sim *sim = sim_of(board);
+
+	sim_call(sim);
+
+	if ((address & 0x03) || address >= IDMF_REG_WINDOW)
+		return -EINVAL;
+
+	sim_write(sim, address, value);
+
+	return 0;
+}
+
+static int sim_xact(struct idmf_sim *sim, struct idmf_xact *xact) {
+	struct idmf_reg_op *ops = (struct idmf_reg_op *) (unsigned long) xact->ops;
+	__u32 i;
+
+	if (xact->count > IDMF_XACT_MAX)
+		return -EINVAL;
+
+	for (i = 0; i < xact->count; i++) {
+		if ((ops[i].offset & 0x03) || ops[i].offset >= IDMF_REG_WINDOW)
+			return -EINVAL;
+
+		switch (ops[i].op) {
+		case IDMF_OP_READ:
+			ops[i].value = sim_read(sim, ops[i].offset);
+			break;
+		case IDMF_OP_WRITE:
+			sim_write(sim, ops[i].offset, ops[i].value);
+			break;
+		default:
+			return -EINVAL;
+		}
+	}
+
+	return 0;
+}
+
+static int sim_prog_load(struct idmf_sim *sim, struct idmf_prog_load *req) {
+	const struct idmf_prog_op *ops =
+			(const struct idmf_prog_op *) (unsigned long) req->ops;
+	__u32 delay = 0;
+	__u32 i;
+	int n;
+
+	if (!req->count || req->count > IDMF_PROG_MAX_OPS)
+		return -EINVAL;
+
+	for (i = 0; i < req->count; i++) {
+		if (ops[i].slot >= IDMF_PROG_SLOTS)
+			return -EINVAL;
+
+		if (ops[i].op == IDMF_PROG_DELAY) {
+			if (ops[i].value > IDMF_PROG_MAX_DELAY - delay)
+				return -EINVAL;
+			delay += ops[i].value;
+			continue;
+		}
+
+		if ((ops[i].offset & 0x03) || ops[i].offset >= IDMF_REG_WINDOW)
+			return -EINVAL;
+
+		if (ops[i].op < IDMF_PROG_READ || ops[i].op > IDMF_PROG_WRITE_IN)
+			return -EINVAL;
+	}
+
+	for (n = 0; n < IDMF_PROG_MAX; n++)
+		if (!sim->prog[n])
+			break;
+
+	if (n == IDMF_PROG_MAX)
+		return -ENOSPC;
+
+	sim->prog[n] = malloc(req->count * sizeof(*ops));
+	if (!sim->prog[n])
+		return -ENOMEM;
+
+	memcpy(sim->prog[n], ops, req->count * sizeof(*ops));
+	sim->prog_count[n] = req->count;
+	req->handle = n + 1;
+
+	return 0;
+}
+
+static int sim_prog_unload(struct idmf_sim *sim, __u32 handle) {
+	if (!handle || handle > IDMF_PROG_MAX || !sim->prog[handle - 1])
+		return -EINVAL;
+
+	free(sim->prog[handle - 1]);
+	sim->prog[handle - 1] = 0;
+
+	return 0;
+}
+
+static int sim_prog_run(struct idmf_sim *sim, struct idmf_prog_run *run) {
+	const struct idmf_prog_op *op;
+	__u32 i;
+
+	if (!run->handle || run->handle > IDMF_PROG_MAX
+			|| !sim->prog[run->handle - 1])
+		return -EINVAL;
+
+	run->timestamp = sim_clock();
+
+	for (i = 0; i < sim->prog_count[run->handle - 1]; i++) {
+		op = &sim->prog[run->handle - 1][i];
+
+		switch (op->op) {
+		case IDMF_PROG_READ:
+			sim_read(sim, op->offset);
+			break;
+		case IDMF_PROG_READ_OUT:
+			run->out[op->slot] = sim_read(sim, op->offset);
+			break;
+		case IDMF_PROG_WRITE:
+			sim_write(sim, op->offset, op->value);
+			break;
+		case IDMF_PROG_WRITE_IN:
+			sim_write(sim, op->offset, run->in[op->slot]);
+			break;
+		case IDMF_PROG_DELAY:
+			sim_delay(op->value);
+			break;
+		}
+	}
+
+	return 0;
+}
+
+static int sim_adc_convert(struct idmf_sim *sim, struct idmf_adc_frame *frame) {
+	int i;
+
+	frame->timestamp = sim_clock();
+
+	sim_write(sim, BCT_ADC, 0x01);
+	sim_write(sim, BCT_ADC, 0x00);
+
+	for (i = 0; i < NUM_ADCS; i++)
+		frame->value[sim_adc_order[i]] = (__s16) sim_read(sim, ADC_DATA);
+
+	return 0;
+}
+
+/* the model converts instantly, the conversion completes on submission */
+static int sim_adc_submit(struct idmf_sim *sim, __u32 *seq) {
+	if (!++sim->adc_seq)
+		sim->adc_seq++;
+
+	sim_adc_convert(sim, &sim->adc_frame);
+	*seq = sim->adc_seq;
+
+	return 0;
+}
+
+static int sim_adc_wait(struct idmf_sim *sim, struct idmf_adc_wait *req) {
+	if (!sim->adc_seq)
+		return -EINVAL;
+
+	req->seq = sim->adc_seq;
+	req->frame = sim->adc_frame;
+
+	return 0;
+}
+
+static int sim_snapshot(struct idmf_sim *sim, struct idmf_snapshot *snap) {
+	struct idmf_adc_frame frame;
+	int i;
+
+	memset(snap, 0, sizeof(*snap));
+
+	sim_adc_convert(sim, &frame);
+
+	snap->timestamp = frame.timestamp;
+	memcpy(snap->adc, frame.value, sizeof(snap->adc));
+
+	for (i = 0; i < NUM_ENCS; i++)
+		snap->enc[i] = (__s32) sim_read(sim, MFC_CNT + i * 0x40);
+
+	for (i = 0; i < NUM_PORTS; i++)
+		snap->port[i] = (__u8) sim_read(sim, PRT_VALUE + i * 0x04);
+
+	snap->gpio = sim_read(sim, GPIO_IN);
+	snap->enc_alarm[0] = sim_read(sim, ENC_ALARM0);
+	snap->enc_alarm[1] = sim_read(sim, ENC_ALARM1);
+	snap->enc_pwrstat = sim_read(sim, ENC_PWRSTAT);
+
+	return 0;
+}
+
+/* writes a register of an output commit unless it already holds the value */
+static int sim_out_write(struct idmf_sim *sim, __u32 address, __u32 value,
+		int force) {
+	if (!force && sim->regs[address >> 2] == value)
+		return 0;
+
+	sim_write(sim, address, value);
+
+	return 1;
+}
+
+static int sim_out_commit(struct idmf_sim *sim,
+		const struct idmf_out_frame *frame) {
+	int force = frame->flags & IDMF_OUT_FORCE;
+	int latch = 0;
+	int i;
+
+	for (i = 0; i < NUM_DACS; i++)
+		if (frame->dac_mask & (1 << i))
+			latch |= sim_out_write(sim, DAC_VALUE + i * 0x04,
+					(__u32) frame->dac[i], force);
+
+	if (latch)
+		sim_write(sim, DAC_CONF, 0x0000C000);
+
+	for (i = 0; i < NUM_PORTS; i++)
+		if (frame->port_mask & (1 << i))
+			sim_out_write(sim, PRT_VALUE + i * 0x04, frame->port[i], force);
+
+	if (frame->flags & IDMF_OUT_GPIO)
+		sim_out_write(sim, GPIO_OUT, frame->gpio, force);
+
+	if (frame->flags & IDMF_OUT_LED)
+		sim_out_write(sim, BCT_LED, frame->led, force);
+
+	return 0;
+}
+
+static int sim_bit_op(struct idmf_sim *sim, struct idmf_bit_op *op) {
+	__u32 address;
+	__u32 mask;
+
+	if (op->target < NUM_PORTS) {
+		address = PRT_VALUE + op->target * 0x04;
+		mask = 0xFF;
+	} else if (op->target == IDMF_BITS_GPIO) {
+		address = GPIO_OUT;
+		mask = 0xFFFFFFFF;
+	} else
+		return -EINVAL;
+
+	/* the model keeps the written value even for input ports */
+	op->value = (((sim->regs[address >> 2] | op->set) & ~op->clear)
+			^ op->toggle) & mask;
+	sim_out_write(sim, address, op->value, 0);
+
+	return 0;
+}
+
+static int sim_claim(struct idmf_sim *sim, struct idmf_claim *claim,
+		int release) {
+	int i;
+
+	if ((claim->dac_mask & ~((1 << NUM_DACS) - 1))
+			|| (claim->enc_mask & ~((1 << NUM_ENCS) - 1))
+			|| (claim->gpio_mask & ~((1 << NUM_GPIOS) - 1))
+			|| claim->reserved)
+		return -EINVAL;
+
+	if (release) {
+		sim->claim.dac_mask &= ~claim->dac_mask;
+		sim->claim.enc_mask &= ~claim->enc_mask;
+		sim->claim.gpio_mask &= ~claim->gpio_mask;
+		for (i = 0; i < NUM_PORTS; i++)
+			sim->claim.port_mask[i] &= ~claim->port_mask[i];
+	} else {
+		sim->claim.dac_mask |= claim->dac_mask;
+		sim->claim.enc_mask |= claim->enc_mask;
+		sim->claim.gpio_mask |= claim->gpio_mask;
+		for (i = 0; i < NUM_PORTS; i++)
+			sim->claim.port_mask[i] |= claim->port_mask[i];
+	}
+
+	*claim = sim->claim;
+
+	return 0;
+}
+
+static void sim_ref_word(struct idmf_sim *sim, __u32 value) {
+	__u32 data;
+	int i;
+
+	sim_write(sim, ADC_REF, 0x00);
+
+	for (i = 23; i >= 0; i--) {
+		data = (value & (1 << i)) ? SIM_REF_DATA : 0;
+
+		sim_write(sim, ADC_REF, data | SIM_REF_CLK);
+		sim_write(sim, ADC_REF, data);
+	}
+
+	sim_write(sim, ADC_REF, SIM_REF_LOAD);
+}
+
+static int sim_adc_ref(struct idmf_sim *sim, const struct idmf_adc_ref *ref) {
+	if (!(ref->flags & IDMF_REF_FORCE) && sim->refina == ref->refina
+			&& sim->refadc == ref->refadc)
+		return 0;
+
+	sim_write(sim, ADC_DATA, 0x0C);
+	sim_ref_word(sim, 0x00100000 | ref->refina);
+	sim_ref_word(sim, 0x00240000 | ref->refadc);
+
+	return 0;
+}
+
+/* a simulated board forms a group of its own */
+static int sim_group_snapshot(struct idmf_sim *sim,
+		struct idmf_group_frame *frame) {
+	sim_snapshot(sim, &frame->board[0]);
+
+	frame->timestamp = frame->board[0].timestamp;
+	frame->boards = 1;
+
+	return 0;
+}
+
+static int sim_ioctl(idmf_board *board, unsigned int request, void *arg) {
+	struct idmf_sim *sim = sim_of(board);
+
+	switch (request) {
+	case IDMF_RTIOC_XACT:
+		sim_call(sim);
+		return sim_xact(sim, (struct idmf_xact *) arg);
+	case IDMF_RTIOC_ADC_CONVERT:
+		sim_call(sim);
+		return sim_adc_convert(sim, (struct idmf_adc_frame *) arg);
+	case IDMF_RTIOC_SNAPSHOT:
+		sim_call(sim);
+		return sim_snapshot(sim, (struct idmf_snapshot *) arg);
+	case IDMF_RTIOC_OUT_COMMIT:
+		sim_call(sim);
+		return sim_out_commit(sim, (const struct idmf_out_frame *) arg);
+	case IDMF_RTIOC_ADC_REF:
+		sim_call(sim);
+		return sim_adc_ref(sim, (const struct idmf_adc_ref *) arg);
+	case IDMF_RTIOC_GROUP_SNAPSHOT:
+		sim_call(sim);
+		return sim_group_snapshot(sim, (struct idmf_group_frame *) arg);
+	case IDMF_RTIOC_BIT_OP:
+		sim_call(sim);
+		return sim_bit_op(sim, (struct idmf_bit_op *) arg);
+	case IDMF_RTIOC_CLAIM:
+		sim_call(sim);
+		return sim_claim(sim, (struct idmf_claim *) arg, 0);
+	case IDMF_RTIOC_RELEASE:
+		sim_call(sim);
+		return sim_claim(sim, (struct idmf_claim *) arg, 1);
+	case IDMF_RTIOC_ADC_SUBMIT:
+		sim_call(sim);
+		return sim_adc_submit(sim, (__u32 *) arg);
+	case IDMF_RTIOC_ADC_WAIT:
+		sim_call(sim);
+		return sim_adc_wait(sim, (struct idmf_adc_wait *) arg);
+	case IDMF_RTIOC_PROG_LOAD:
+		sim_call(sim);
+		return sim_prog_load(sim, (struct idmf_prog_load *) arg);
+	case IDMF_RTIOC_PROG_UNLOAD:
+		sim_call(sim);
+		return sim_prog_unload(sim, *(__u32 *) arg);
+	case IDMF_RTIOC_PROG_RUN:
+		sim_call(sim);
+		return sim_prog_run(sim, (struct idmf_prog_run *) arg);
+	default:
+		return -ENOTTY;
+	}
+}
+
+const idmf_transport idmf_sim_transport = {
+	.name = "sim",
+	.open = sim_open,
+	.close = sim_close,
+	.reg_read = sim_reg_read,
+	.reg_write = sim_reg_write,
+	.ioctl = sim_ioctl,
+};
+
+/*****************************************************************************/
+/* simulator control */
+
+/**
+ * idmf_sim_set_latency - set the simulated access costs
+ * @board:	the simulated board
+ * @call_ns:	busy wait charged per transport call, i.e. per syscall
+ * @access_ns:	busy wait charged per register access
+ */
+void idmf_sim_set_latency(idmf_board *board, __u32 call_ns, __u32 access_ns) {
+	if (board->transport != &idmf_sim_transport)
+		return;
+
+	sim_of(board)->call_ns = call_ns;
+	sim_of(board)->access_ns = access_ns;
+}
+
+/**
+ * idmf_sim_get_stats - get the number of calls and register accesses
+ * @board:	the simulated board
+ * @calls:	number of transport calls, may be NULL
+ * @accesses:	number of register accesses, may be NULL
+ */
+void idmf_sim_get_stats(idmf_board *board, __u64 *calls, __u64 *accesses) {
+	if (board->transport != &idmf_sim_transport)
+		return;
+
+	if (calls)
+		*calls = sim_of(board)->calls;
+
+	if (accesses)
+		*accesses = sim_of(board)->accesses;
+}
+
+/**
+ * idmf_sim_set_adc - drive an analog input
+ * @board:	the simulated board
+ * @channel:	the channel of the ADC on the board
+ * @value:	the value returned by following conversions
+ *
+ * Until a value is set, an ADC channel samples the output of the DAC with the
+ * same number.
+ */
+void idmf_sim_set_adc(idmf_board *board, int channel, __s16 value) {
+	if (board->transport != &idmf_sim_transport)
+		return;
+
+	if ((channel < 0) || (channel >= NUM_ADCS))
+		return;
+
+	sim_of(board)->adc_in[channel] = value;
+	sim_of(board)->adc_forced |= 1 << channel;
+}
+
+/**
+ * idmf_sim_clear_adc - return an analog input to the DAC loopback
+ * @board:	the simulated board
+ * @channel:	the channel of the ADC on the board
+ */
+void idmf_sim_clear_adc(idmf_board *board, int channel) {
+	if (board->transport != &idmf_sim_transport)
+		return;
+
+	if ((channel < 0) || (channel >= NUM_ADCS))
+		return;
+
+	sim_of(board)->adc_forced &= ~(1 << channel);
+}
+
+/**
+ * idmf_sim_get_dac - get the output of a DAC
+ * @board:	the simulated board
+ * @channel:	the channel of the DAC on the board
+ *
+ * This function returns the value latched by the last idmf_dac_update.
+ */
+__s16 idmf_sim_get_dac(idmf_board *board, int channel) {
+	if (board->transport != &idmf_sim_transport)
+		return 0;
+
+	if ((channel < 0) || (channel >= NUM_DACS))
+		return 0;
+
+	return sim_of(board)->dac_out[channel];
+}
+
+/**
+ * idmf_sim_get_ref - get the reference values shifted in through ADC_REF
+ * @board:	the simulated board
+ * @refadc:	reference voltage of ADC, may be NULL
+ * @refina:	reference voltage of INA, may be NULL
+ */
+void idmf_sim_get_ref(idmf_board *board, __u16 *refadc, __u16 *refina) {
+	if (board->transport != &idmf_sim_transport)
+		return;
+
+	if (refadc)
+		*refadc = sim_of(board)->refadc;
+
+	if (refina)
+		*refina = sim_of(board)->refina;
+}
+
+/**
+ * idmf_sim_set_port_in - drive the pins of a data port
+ * @board:	the simulated board
+ * @port:	the port on the board
+ * @value:	the signals seen while the port is configured as an input
+ */
+void idmf_sim_set_port_in(idmf_board *board, int port, __u8 value) {
+	if (board->transport != &idmf_sim_transport)
+		return;
+
+	if ((port < 0) || (port >= NUM_PORTS))
+		return;
+
+	sim_of(board)->port_in[port] = value;
+}
+
+/**
+ * idmf_sim_set_gpio_in - drive the general-purpose I/O pins
+ * @board:	the simulated board
+ * @values:	the signals seen on the pins configured as inputs
+ */
+void idmf_sim_set_gpio_in(idmf_board *board, __u32 values) {
+	if (board->transport != &idmf_sim_transport)
+		return;
+
+	sim_of(board)->gpio_in = values;
+}
+
+/**
+ * idmf_sim_enc_move - move an encoder
+ * @board:	the simulated board
+ * @channel:	the channel of the encoder on the board
+ * @delta:	number of counts added to the counter
+ */
+void idmf_sim_enc_move(idmf_board *board, int channel, __s32 delta) {
+	if (board->transport != &idmf_sim_transport)
+		return;
+
+	if ((channel < 0) || (channel >= NUM_ENCS))
+		return;
+
+	sim_of(board)->enc_cnt[channel] += delta;
+}
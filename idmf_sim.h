@@ -0,0 +1,58 @@
+/*
+ * Author Wojciech Domski 2015
+ * www.domski.pl
+ *
+ * Software model of the IDMF board used as an in-process transport of the
+ * API. It allows to run and benchmark applications without the hardware and
+ * without a Xenomai kernel.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef __IDMF_SIM_H
+#define __IDMF_SIM_H
+
+#include "idmf_api.h"
+
+/*
+ * default latencies in nanoseconds, overridden by the IDMF_SIM_CALL_NS and
+ * IDMF_SIM_ACCESS_NS environment variables when the board is opened
+ */
+#define IDMF_SIM_CALL_NS	0
+#define IDMF_SIM_ACCESS_NS	0
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern const idmf_transport idmf_sim_transport;
+
+void idmf_sim_set_latency(idmf_board *board, __u32 call_ns, __u32 access_ns);
+void idmf_sim_get_stats(idmf_board *board, __u64 *calls, __u64 *accesses);
+
+void idmf_sim_set_adc(idmf_board *board, int channel, __s16 value);
+void idmf_sim_clear_adc(idmf_board *board, int channel);
+__s16 idmf_sim_get_dac(idmf_board *board, int channel);
+void idmf_sim_get_ref(idmf_board *board, __u16 *refadc, __u16 *refina);
+
+void idmf_sim_set_port_in(idmf_board *board, int port, __u8 value);
+void idmf_sim_set_gpio_in(idmf_board *board, __u32 values);
+void idmf_sim_enc_move(idmf_board *board, int channel, __s32 delta);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif